@@ -1,15 +1,19 @@
 #include "lang/seq.h"
+#include <algorithm>
 #include <queue>
 #include <utility>
 
 using namespace seq;
 using namespace llvm;
 
-PipeExpr::PipeExpr(std::vector<seq::Expr *> stages, std::vector<bool> parallel)
+PipeExpr::PipeExpr(std::vector<seq::Expr *> stages, std::vector<bool> parallel,
+                   std::vector<bool> ordered)
     : Expr(), stages(std::move(stages)), parallel(std::move(parallel)),
-      entry(nullptr), syncReg(nullptr) {
+      ordered(std::move(ordered)), entry(nullptr), syncReg(nullptr) {
   if (this->parallel.empty())
     this->parallel = std::vector<bool>(this->stages.size(), false);
+  if (this->ordered.empty())
+    this->ordered = std::vector<bool>(this->stages.size(), false);
 }
 
 void PipeExpr::setParallel(unsigned which) {
@@ -17,6 +21,11 @@ void PipeExpr::setParallel(unsigned which) {
   parallel[which] = true;
 }
 
+void PipeExpr::setOrdered(unsigned which) {
+  assert(which < ordered.size());
+  ordered[which] = true;
+}
+
 void PipeExpr::resolveTypes() {
   for (auto *stage : stages)
     stage->resolveTypes();
@@ -39,11 +48,12 @@ struct DrainState {
   types::GenType *type;      // type of prefetch generator
   std::queue<Expr *> stages; // remaining pipeline stages
   std::queue<bool> parallel;
+  std::queue<bool> ordered;
 
   DrainState()
       : states(nullptr), filled(nullptr), statesTemp(nullptr), pairs(nullptr),
         pairsTemp(nullptr), bufRef(nullptr), bufQer(nullptr), params(nullptr),
-        hist(nullptr), type(nullptr), stages(), parallel() {}
+        hist(nullptr), type(nullptr), stages(), parallel(), ordered() {}
 };
 
 struct seq::PipeExpr::PipelineCodegenState {
@@ -52,18 +62,22 @@ struct seq::PipeExpr::PipelineCodegenState {
   BasicBlock *block;         // current codegen block
   std::queue<Expr *> stages; // stages left to codegen
   std::queue<bool> parallel; // parallel ("||>") stages
+  std::queue<bool> ordered;  // stages ending an ordered section (">|")
 
   bool inParallel; // whether current stage is in parallel section
   bool inLoop;     // whether we are in a loop (i.e. past some generator stage)
   bool nestedParallel; // whether this pipeline has multiple parallel stages
 
+  // entry block of the parallel task we are in, if any, for task-local state
+  BasicBlock *taskEntry;
+
   DrainState drain; // drain state for prefetch and inter-align optimizations
 
   PipelineCodegenState(BasicBlock *block, std::queue<Expr *> stages,
-                       std::queue<bool> parallel)
+                       std::queue<bool> parallel, std::queue<bool> ordered)
       : type(nullptr), val(nullptr), block(block), stages(std::move(stages)),
-        parallel(), inParallel(false), inLoop(false), nestedParallel(false),
-        drain() {
+        parallel(), ordered(std::move(ordered)), inParallel(false),
+        inLoop(false), nestedParallel(false), taskEntry(nullptr), drain() {
     int numParallels = 0;
     while (!parallel.empty()) {
       bool p = parallel.front();
@@ -76,7 +90,8 @@ struct seq::PipeExpr::PipelineCodegenState {
 
   PipelineCodegenState getDrainState(Value *val, types::Type *type,
                                      BasicBlock *block) {
-    PipelineCodegenState state(block, drain.stages, drain.parallel);
+    PipelineCodegenState state(block, drain.stages, drain.parallel,
+                               drain.ordered);
     state.val = val;
     state.type = type;
     return state;
@@ -146,12 +161,14 @@ struct UnpackedStage {
  * the latter is only done once.
  */
 static void applyRevCompOptimization(std::vector<Expr *> &stages,
-                                     std::vector<bool> &parallel) {
+                                     std::vector<bool> &parallel,
+                                     std::vector<bool> &ordered) {
   std::vector<Expr *> stagesNew;
   std::vector<bool> parallelNew;
+  std::vector<bool> orderedNew;
   unsigned i = 0;
   while (i < stages.size()) {
-    if (i < stages.size() - 1) {
+    if (i < stages.size() - 1 && !ordered[i]) {
       UnpackedStage f1(stages[i]);
       UnpackedStage f2(stages[i + 1]);
 
@@ -165,6 +182,7 @@ static void applyRevCompOptimization(std::vector<Expr *> &stages,
         stagesNew.push_back(f1.repack(Func::getBuiltin(replacement)));
         stagesNew.back()->resolveTypes();
         parallelNew.push_back(parallel[i] || parallel[i + 1]);
+        orderedNew.push_back(ordered[i + 1]);
         i += 2;
         continue;
       }
@@ -172,46 +190,44 @@ static void applyRevCompOptimization(std::vector<Expr *> &stages,
 
     stagesNew.push_back(stages[i]);
     parallelNew.push_back(parallel[i]);
+    orderedNew.push_back(ordered[i]);
     ++i;
   }
   stages = stagesNew;
   parallel = parallelNew;
+  ordered = orderedNew;
 }
 
 /*
  * Canonical k-mer optimization optimizes kmers |> canonical by using two
  * sliding windows to iterate over both forward and reverse k-mers
- * simultaneously. Currently only works with step=1 but probably possible to
- * support arbitrary step size.
+ * simultaneously. The windows slide over every base, so that only k-mers
+ * at multiples of the step size are yielded, but no k-mer is ever reverse
+ * complemented from scratch.
  */
 static void applyCanonicalKmerOptimization(std::vector<Expr *> &stages,
-                                           std::vector<bool> &parallel) {
+                                           std::vector<bool> &parallel,
+                                           std::vector<bool> &ordered) {
   std::vector<Expr *> stagesNew;
   std::vector<bool> parallelNew;
+  std::vector<bool> orderedNew;
   unsigned i = 0;
   while (i < stages.size()) {
-    if (i < stages.size() - 1) {
+    if (i < stages.size() - 1 && !ordered[i]) {
       UnpackedStage f1(stages[i]);
       UnpackedStage f2(stages[i + 1]);
 
-      seq_int_t step = -1;
-      if (!f1.args.empty()) {
-        if (auto *e = dynamic_cast<IntExpr *>(f1.args[0]))
-          step = e->value();
-      }
-
       std::string replacement = "";
-      if (step == 1 && f1.matches("kmers", 1) && f2.matches("canonical"))
+      if (f1.matches("kmers", 1) && f2.matches("canonical"))
         replacement = "_kmers_canonical";
-      if (step == 1 && f1.matches("kmers_with_pos", 1) &&
-          f2.matches("canonical_with_pos"))
+      if (f1.matches("kmers_with_pos", 1) && f2.matches("canonical_with_pos"))
         replacement = "_kmers_canonical_with_pos";
 
       if (!replacement.empty()) {
-        stagesNew.push_back(
-            new FuncExpr(Func::getBuiltin(replacement), f1.func->getTypes()));
+        stagesNew.push_back(f1.repack(Func::getBuiltin(replacement)));
         stagesNew.back()->resolveTypes();
         parallelNew.push_back(parallel[i] || parallel[i + 1]);
+        orderedNew.push_back(ordered[i + 1]);
         i += 2;
         continue;
       }
@@ -219,10 +235,45 @@ static void applyCanonicalKmerOptimization(std::vector<Expr *> &stages,
 
     stagesNew.push_back(stages[i]);
     parallelNew.push_back(parallel[i]);
+    orderedNew.push_back(ordered[i]);
     ++i;
   }
   stages = stagesNew;
   parallel = parallelNew;
+  ordered = orderedNew;
+}
+
+/*
+ * A ">|" ends the ordered section of a parallel generator stage, so it must
+ * follow a "||>" generator stage with only plain, serial stages in between.
+ * This is checked here, whether or not the pipeline ends up running in
+ * parallel, so that misplaced ones are not silently ignored.
+ */
+static void validateOrdered(const std::vector<Expr *> &stages,
+                            const std::vector<bool> &parallel,
+                            const std::vector<bool> &ordered) {
+  types::Type *type = nullptr;
+  bool inSection = false;
+  for (unsigned i = 0; i < stages.size(); i++) {
+    if (!type) {
+      type = stages[i]->getType();
+    } else {
+      ValueExpr arg(type, nullptr);
+      CallExpr call(stages[i], {&arg});
+      type = call.getType();
+    }
+
+    types::GenType *genType = type->asGen();
+    if (ordered[i] && (genType || !inSection))
+      throw exc::SeqException("'>|' must follow a parallel generator stage");
+
+    if (genType) {
+      inSection = parallel[i];
+      type = genType->getBaseType(0);
+    } else if (parallel[i] || ordered[i]) {
+      inSection = false;
+    }
+  }
 }
 
 // make sure params are globals or literals, since codegen'ing in function entry
@@ -291,6 +342,7 @@ Value *PipeExpr::validateAndCodegenInterAlignParams(
 Value *PipeExpr::codegenPipe(BaseFunc *base,
                              PipeExpr::PipelineCodegenState &state) {
   assert(state.stages.size() == state.parallel.size());
+  assert(state.stages.size() == state.ordered.size());
   if (state.stages.empty())
     return state.val;
 
@@ -301,8 +353,15 @@ Value *PipeExpr::codegenPipe(BaseFunc *base,
 
   Expr *stage = state.stages.front();
   bool parallelize = state.parallel.front();
+  bool order = state.ordered.front();
   state.stages.pop();
   state.parallel.pop();
+  state.ordered.pop();
+
+  // codegenParallelLoop() consumes the ">|" of its ordered section; any
+  // other one would be silently ignored
+  if (order)
+    throw exc::SeqException("'>|' must follow a parallel generator stage");
 
   Value *val0 = state.val;
   types::Type *type0 = state.type;
@@ -338,19 +397,24 @@ Value *PipeExpr::codegenPipe(BaseFunc *base,
      * done. This entails codegen'ing a simple dynamic scheduler at
      * this point in the pipeline, as well as a "drain" loop after
      * the pipeline to complete any remaining calls.
+     *
+     * Within a parallel task, the scheduler state lives in the task
+     * and is drained at the end of the task, so each thread interleaves
+     * the calls of the chunk it is working on.
      */
-    if (parallelize || state.inParallel)
+    if (parallelize || (state.inParallel && !state.taskEntry))
       throw exc::SeqException(
           "parallel prefetch transformation currently not supported");
 
-    BasicBlock *preamble = base->getPreamble();
+    BasicBlock *preamble =
+        state.taskEntry ? state.taskEntry : base->getPreamble();
     IRBuilder<> builder(preamble);
     Value *states = makeAlloca(builder.getInt8PtrTy(), preamble,
                                PipeExpr::SCHED_WIDTH_PREFETCH);
     Value *next = makeAlloca(seqIntLLVM(context), preamble);
     Value *filled = makeAlloca(seqIntLLVM(context), preamble);
 
-    builder.SetInsertPoint(entry);
+    builder.SetInsertPoint(state.taskEntry ? state.taskEntry : entry);
     builder.CreateStore(zeroLLVM(context), next);
     builder.CreateStore(zeroLLVM(context), filled);
 
@@ -411,6 +475,7 @@ Value *PipeExpr::codegenPipe(BaseFunc *base,
     state.drain.type = genType;
     state.drain.stages = state.stages;
     state.drain.parallel = state.parallel;
+    state.drain.ordered = state.ordered;
 
     state.block = genDone;
     codegenPipe(base, state);
@@ -538,6 +603,7 @@ Value *PipeExpr::codegenPipe(BaseFunc *base,
     state.drain.type = genType;
     state.drain.stages = state.stages;
     state.drain.parallel = state.parallel;
+    state.drain.ordered = state.ordered;
 
     builder.SetInsertPoint(notFull);
     N = builder.CreateLoad(filled);
@@ -548,6 +614,11 @@ Value *PipeExpr::codegenPipe(BaseFunc *base,
     state.block = exit;
     return nullptr;
   } else if (genType && stage != state.stages.back()) {
+#if SEQ_HAS_TAPIR
+    if (parallelize)
+      return codegenParallelLoop(base, state, genType);
+#endif
+
     /*
      * Plain generator -- create implicit for-loop
      */
@@ -579,19 +650,6 @@ Value *PipeExpr::codegenPipe(BaseFunc *base,
                     ? nullptr
                     : genType->promise(gen, state.block);
 
-#if SEQ_HAS_TAPIR
-    if (parallelize) {
-      BasicBlock *unwind = tc ? tc->getExceptionBlock() : nullptr;
-      BasicBlock *detach = BasicBlock::Create(context, "detach", func);
-      builder.SetInsertPoint(state.block);
-      if (unwind)
-        builder.CreateDetach(detach, loop0, unwind, syncReg);
-      else
-        builder.CreateDetach(detach, loop0, syncReg);
-      state.block = detach;
-    }
-#endif
-
     BasicBlock *cleanup = BasicBlock::Create(context, "cleanup", func);
     branch->setSuccessor(0, cleanup);
 
@@ -599,22 +657,13 @@ Value *PipeExpr::codegenPipe(BaseFunc *base,
     bool oldInLoop = state.inLoop;
     bool oldInParallel = state.inParallel;
     state.inLoop = true;
-    state.inParallel = parallelize;
+    state.inParallel = false;
     codegenPipe(base, state);
     state.inLoop = oldInLoop;
     state.inParallel = oldInParallel;
 
     builder.SetInsertPoint(state.block);
-
-#if SEQ_HAS_TAPIR
-    if (parallelize) {
-      builder.CreateReattach(loop0, syncReg);
-    } else {
-#endif
-      builder.CreateBr(loop0);
-#if SEQ_HAS_TAPIR
-    }
-#endif
+    builder.CreateBr(loop0);
 
     genType->destroy(gen, cleanup);
     BasicBlock *exit = BasicBlock::Create(context, "exit", func);
@@ -660,6 +709,545 @@ Value *PipeExpr::codegenPipe(BaseFunc *base,
   }
 }
 
+#if SEQ_HAS_TAPIR
+/*
+ * Parallel ("||>") generator stage
+ *
+ * Spawning a task per item costs more than the item itself for small work
+ * items (e.g. k-mers), so instead we buffer items into chunks and spawn one
+ * task per chunk that runs the rest of the pipeline over each of its items.
+ * Tasks go on the spawning thread's OpenMP task deque, from which idle
+ * threads steal them. Chunk sizes come from seq_pipeline_chunk_size(): a
+ * single item per task until every thread has had one, then doubling up to
+ * a limit, so that short pipelines still spread out over all threads.
+ *
+ * If a later stage is followed by ">|", only the stages up to that point
+ * (the "ordered section") run in the tasks, which store their outputs back
+ * into the chunk. The spawning thread then retires chunks in the order they
+ * were spawned, passing their outputs to the remaining stages serially, so
+ * that those see items in input order. At most SCHED_WIDTH_ORDERED chunks
+ * are in flight at once; once that many are, the spawning thread waits for
+ * the oldest before reading more input.
+ */
+Value *PipeExpr::codegenParallelLoop(BaseFunc *base,
+                                     PipeExpr::PipelineCodegenState &state,
+                                     types::GenType *genType) {
+  LLVMContext &context = state.block->getContext();
+  Module *module = state.block->getModule();
+  Function *func = state.block->getParent();
+  TryCatch *tc = getTryCatch();
+  BasicBlock *unwind = tc ? tc->getExceptionBlock() : nullptr;
+
+  types::Type *type = genType->getBaseType(0);
+  const bool hasVal = !type->is(types::Void);
+  llvm::Type *valType =
+      hasVal ? type->getLLVMType(context) : IntegerType::getInt8Ty(context);
+  PointerType *bufType = valType->getPointerTo();
+  Value *nullBuf = ConstantPointerNull::get(bufType);
+  Value *limit =
+      ConstantInt::get(seqIntLLVM(context), config::config().pipelineChunk);
+
+  // split off the ordered section, if any
+  std::queue<Expr *> orderedStages;
+  std::queue<bool> orderedParallel;
+  std::queue<bool> orderedOrdered;
+  types::Type *outType = type;
+  bool isOrdered = false;
+  {
+    std::queue<Expr *> stages(state.stages);
+    std::queue<bool> parallel(state.parallel);
+    std::queue<bool> ordered(state.ordered);
+    bool anyOrdered = false;
+    for (std::queue<bool> q(ordered); !q.empty(); q.pop())
+      anyOrdered = anyOrdered || q.front();
+
+    while (anyOrdered && !isOrdered) {
+      Expr *stage = stages.front();
+      if (parallel.front())
+        throw exc::SeqException(
+            "parallel pipe cannot appear before '>|' in a parallel pipeline");
+      ValueExpr arg(outType, nullptr);
+      CallExpr call(stage, {&arg});
+      outType = call.getType();
+      if (outType->asGen())
+        throw exc::SeqException(
+            "generator stage cannot appear before '>|' in a parallel pipeline");
+      orderedStages.push(stage);
+      orderedParallel.push(false);
+      orderedOrdered.push(false);
+      isOrdered = ordered.front();
+      stages.pop();
+      parallel.pop();
+      ordered.pop();
+    }
+  }
+
+  if (isOrdered) {
+    for (unsigned i = 0; i < orderedStages.size(); i++) {
+      state.stages.pop();
+      state.parallel.pop();
+      state.ordered.pop();
+    }
+  }
+
+  const bool hasOut = isOrdered && !outType->is(types::Void);
+  llvm::Type *outValType =
+      hasOut ? outType->getLLVMType(context) : IntegerType::getInt8Ty(context);
+  PointerType *outBufType = outValType->getPointerTo();
+  Value *nullOutBuf = ConstantPointerNull::get(outBufType);
+
+  auto *chunkSizeFunc = cast<Function>(module->getOrInsertFunction(
+      "seq_pipeline_chunk_size", seqIntLLVM(context), seqIntLLVM(context),
+      seqIntLLVM(context)));
+  chunkSizeFunc->setDoesNotThrow();
+  Function *alloc = makeAllocFunc(module, /*atomic=*/false);
+  Function *allocAtomic = makeAllocFunc(module, /*atomic=*/true);
+
+  Value *gen = state.val;
+  BasicBlock *preheader = state.block;
+  IRBuilder<> builder(preheader);
+
+  // reorder window: output buffer, length and completion flag of each chunk
+  // in flight, indexed by spawn order modulo the window size, along with
+  // the indices of the oldest and next chunks
+  const unsigned W = PipeExpr::SCHED_WIDTH_ORDERED;
+  Value *winOut = nullptr;
+  Value *winLen = nullptr;
+  Value *winDone = nullptr;
+  Value *winHead = nullptr;
+  Value *winTail = nullptr;
+  if (isOrdered) {
+    Value *n = builder.getInt64(W);
+    winOut = builder.CreateBitCast(
+        builder.CreateCall(alloc, builder.CreateMul(
+                                      n, builder.getInt64(sizeof(void *)))),
+        outBufType->getPointerTo());
+    winLen = builder.CreateBitCast(
+        builder.CreateCall(allocAtomic,
+                           builder.getInt64((W + 2) * sizeof(seq_int_t))),
+        seqIntLLVM(context)->getPointerTo());
+    winDone = builder.CreateBitCast(
+        builder.CreateCall(allocAtomic,
+                           builder.getInt64(W * sizeof(seq_int_t))),
+        seqIntLLVM(context)->getPointerTo());
+    winHead = builder.CreateGEP(winLen, builder.getInt64(W));
+    winTail = builder.CreateGEP(winLen, builder.getInt64(W + 1));
+    builder.CreateStore(zeroLLVM(context), winHead);
+    builder.CreateStore(zeroLLVM(context), winTail);
+  }
+
+  BasicBlock *loop = BasicBlock::Create(context, "pipe", func);
+  BasicBlock *loop0 = loop;
+  builder.CreateBr(loop);
+
+  // chunk currently being filled: input and output buffers, items so far,
+  // capacity, and the number of tasks spawned so far by this loop
+  builder.SetInsertPoint(loop);
+  PHINode *buf = builder.CreatePHI(bufType, 3);
+  PHINode *out = builder.CreatePHI(outBufType, 3);
+  PHINode *len = builder.CreatePHI(seqIntLLVM(context), 3);
+  PHINode *cap = builder.CreatePHI(seqIntLLVM(context), 3);
+  PHINode *tasks = builder.CreatePHI(seqIntLLVM(context), 3);
+  buf->addIncoming(nullBuf, preheader);
+  out->addIncoming(nullOutBuf, preheader);
+  len->addIncoming(zeroLLVM(context), preheader);
+  cap->addIncoming(zeroLLVM(context), preheader);
+  tasks->addIncoming(zeroLLVM(context), preheader);
+
+  if (tc) {
+    BasicBlock *normal = BasicBlock::Create(context, "normal", func);
+    genType->resume(gen, loop, normal, unwind);
+    loop = normal;
+  } else {
+    genType->resume(gen, loop, nullptr, nullptr);
+  }
+
+  Value *done = genType->done(gen, loop);
+  BasicBlock *body = BasicBlock::Create(context, "body", func);
+  BasicBlock *cleanup = BasicBlock::Create(context, "cleanup", func);
+  builder.SetInsertPoint(loop);
+  builder.CreateCondBr(done, cleanup, body);
+
+  Value *val = hasVal ? genType->promise(gen, body) : nullptr;
+  BasicBlock *newChunk = BasicBlock::Create(context, "new_chunk", func);
+  BasicBlock *append = BasicBlock::Create(context, "append", func);
+  builder.SetInsertPoint(body);
+  builder.CreateCondBr(builder.CreateICmpEQ(len, zeroLLVM(context)), newChunk,
+                       append);
+
+  builder.SetInsertPoint(newChunk);
+  Value *newCap = builder.CreateCall(chunkSizeFunc, {tasks, limit});
+  Value *newBuf = nullBuf;
+  Value *newOut = nullOutBuf;
+  if (hasVal) {
+    Value *size = builder.CreateMul(
+        newCap, ConstantInt::get(seqIntLLVM(context), type->size(module)));
+    newBuf = builder.CreateBitCast(builder.CreateCall(alloc, size), bufType);
+  }
+  if (hasOut) {
+    Value *size = builder.CreateMul(
+        newCap, ConstantInt::get(seqIntLLVM(context), outType->size(module)));
+    newOut =
+        builder.CreateBitCast(builder.CreateCall(alloc, size), outBufType);
+  }
+  builder.CreateBr(append);
+
+  builder.SetInsertPoint(append);
+  PHINode *buf1 = builder.CreatePHI(bufType, 2);
+  PHINode *out1 = builder.CreatePHI(outBufType, 2);
+  PHINode *cap1 = builder.CreatePHI(seqIntLLVM(context), 2);
+  buf1->addIncoming(buf, body);
+  buf1->addIncoming(newBuf, newChunk);
+  out1->addIncoming(out, body);
+  out1->addIncoming(newOut, newChunk);
+  cap1->addIncoming(cap, body);
+  cap1->addIncoming(newCap, newChunk);
+  if (hasVal)
+    builder.CreateStore(val, builder.CreateGEP(buf1, len));
+  Value *len1 = builder.CreateAdd(len, oneLLVM(context));
+  BasicBlock *flush = BasicBlock::Create(context, "flush", func);
+  builder.CreateCondBr(builder.CreateICmpSGE(len1, cap1), flush, loop0);
+  buf->addIncoming(buf1, append);
+  out->addIncoming(out1, append);
+  len->addIncoming(len1, append);
+  cap->addIncoming(cap1, append);
+  tasks->addIncoming(tasks, append);
+
+  // spawn the last partial chunk once the generator is exhausted
+  BasicBlock *finish = BasicBlock::Create(context, "finish", func);
+  BasicBlock *retire = nullptr;
+  if (isOrdered) {
+    // ... and retire all chunks still in flight, even if there is none
+    retire = BasicBlock::Create(context, "retire", func);
+    builder.SetInsertPoint(cleanup);
+    builder.CreateCondBr(builder.CreateICmpSGT(len, zeroLLVM(context)), flush,
+                         retire);
+  } else {
+    builder.SetInsertPoint(cleanup);
+    builder.CreateCondBr(builder.CreateICmpSGT(len, zeroLLVM(context)), flush,
+                         finish);
+  }
+
+  builder.SetInsertPoint(flush);
+  PHINode *chunkBuf = builder.CreatePHI(bufType, 2);
+  PHINode *chunkOut = builder.CreatePHI(outBufType, 2);
+  PHINode *chunkLen = builder.CreatePHI(seqIntLLVM(context), 2);
+  PHINode *last = builder.CreatePHI(builder.getInt1Ty(), 2);
+  chunkBuf->addIncoming(buf1, append);
+  chunkBuf->addIncoming(buf, cleanup);
+  chunkOut->addIncoming(out1, append);
+  chunkOut->addIncoming(out, cleanup);
+  chunkLen->addIncoming(len1, append);
+  chunkLen->addIncoming(len, cleanup);
+  last->addIncoming(builder.getFalse(), append);
+  last->addIncoming(builder.getTrue(), cleanup);
+
+  Value *chunkDoneFlag = nullptr;
+  if (isOrdered) {
+    Value *tail = builder.CreateLoad(winTail);
+    Value *slot = builder.CreateAnd(tail, builder.getInt64(W - 1));
+    builder.CreateStore(chunkOut, builder.CreateGEP(winOut, slot));
+    builder.CreateStore(chunkLen, builder.CreateGEP(winLen, slot));
+    chunkDoneFlag = builder.CreateGEP(winDone, slot);
+    builder.CreateStore(zeroLLVM(context), chunkDoneFlag);
+    builder.CreateStore(builder.CreateAdd(tail, oneLLVM(context)), winTail);
+  }
+
+  BasicBlock *detach = BasicBlock::Create(context, "detach", func);
+  BasicBlock *cont = BasicBlock::Create(context, "continue", func);
+  if (unwind)
+    builder.CreateDetach(detach, cont, unwind, syncReg);
+  else
+    builder.CreateDetach(detach, cont, syncReg);
+
+  // task body: run the rest of the pipeline (or the ordered section) over
+  // each item of the chunk
+  BasicBlock *chunkLoop = BasicBlock::Create(context, "chunk", func);
+  BasicBlock *chunkBody = BasicBlock::Create(context, "chunk_body", func);
+  BasicBlock *chunkDone = BasicBlock::Create(context, "chunk_done", func);
+
+  builder.SetInsertPoint(chunkLoop);
+  PHINode *idx = builder.CreatePHI(seqIntLLVM(context), 2);
+  idx->addIncoming(zeroLLVM(context), detach);
+  builder.CreateCondBr(builder.CreateICmpSLT(idx, chunkLen), chunkBody,
+                       chunkDone);
+
+  builder.SetInsertPoint(chunkBody);
+  Value *item =
+      hasVal ? builder.CreateLoad(builder.CreateGEP(chunkBuf, idx)) : nullptr;
+  BasicBlock *chunkNext = nullptr;
+
+  if (isOrdered) {
+    PipeExpr::PipelineCodegenState section(chunkBody, orderedStages,
+                                           orderedParallel, orderedOrdered);
+    section.val = item;
+    section.type = type;
+    section.inLoop = true;
+    section.inParallel = true;
+    Value *result = codegenPipe(base, section);
+    chunkNext = section.block;
+    if (hasOut) {
+      builder.SetInsertPoint(chunkNext);
+      builder.CreateStore(result, builder.CreateGEP(chunkOut, idx));
+    }
+  } else {
+    state.block = chunkBody;
+    state.type = type;
+    state.val = item;
+
+    // save and restore state to codegen next stage
+    bool oldInLoop = state.inLoop;
+    bool oldInParallel = state.inParallel;
+    BasicBlock *oldTaskEntry = state.taskEntry;
+    const bool hadDrain = state.drain.states != nullptr;
+    state.inLoop = true;
+    state.inParallel = true;
+    state.taskEntry = detach;
+    codegenPipe(base, state);
+    state.inLoop = oldInLoop;
+    state.inParallel = oldInParallel;
+    state.taskEntry = oldTaskEntry;
+    chunkNext = state.block;
+
+    // complete prefetch calls still in flight at the end of the chunk
+    if (!hadDrain && state.drain.states) {
+      state.block = chunkDone;
+      codegenDrain(base, state);
+      chunkDone = state.block;
+      state.drain = DrainState();
+    }
+  }
+
+  // task-local state has been set up by now
+  builder.SetInsertPoint(detach);
+  builder.CreateBr(chunkLoop);
+
+  builder.SetInsertPoint(chunkNext);
+  idx->addIncoming(builder.CreateAdd(idx, oneLLVM(context)), chunkNext);
+  builder.CreateBr(chunkLoop);
+
+  builder.SetInsertPoint(chunkDone);
+  if (isOrdered) {
+    auto *doneFunc = cast<Function>(module->getOrInsertFunction(
+        "seq_pipeline_chunk_done", builder.getVoidTy(),
+        seqIntLLVM(context)->getPointerTo()));
+    doneFunc->setDoesNotThrow();
+    builder.CreateCall(doneFunc, chunkDoneFlag);
+  }
+  builder.CreateReattach(cont, syncReg);
+
+  builder.SetInsertPoint(cont);
+  Value *tasks1 = builder.CreateAdd(tasks, oneLLVM(context));
+  BasicBlock *next = cont;
+
+  if (isOrdered) {
+    /*
+     * Retire chunks in spawn order: those that are already done, plus the
+     * oldest one if the window is full or we're finishing up.
+     */
+    auto *readyFunc = cast<Function>(module->getOrInsertFunction(
+        "seq_pipeline_chunk_ready", builder.getInt1Ty(),
+        seqIntLLVM(context)->getPointerTo()));
+    readyFunc->setDoesNotThrow();
+    auto *waitFunc = cast<Function>(module->getOrInsertFunction(
+        "seq_pipeline_chunk_wait", builder.getVoidTy(),
+        seqIntLLVM(context)->getPointerTo()));
+    waitFunc->setDoesNotThrow();
+
+    BasicBlock *retireCheck = BasicBlock::Create(context, "retire_check", func);
+    BasicBlock *retireChunk = BasicBlock::Create(context, "retire_chunk", func);
+    BasicBlock *retireExit = BasicBlock::Create(context, "retire_exit", func);
+    builder.CreateBr(retire);
+
+    builder.SetInsertPoint(retire);
+    PHINode *retireLast = builder.CreatePHI(builder.getInt1Ty(), 3);
+    PHINode *retireTasks = builder.CreatePHI(seqIntLLVM(context), 3);
+    retireLast->addIncoming(last, cont);
+    retireLast->addIncoming(builder.getTrue(), cleanup);
+    retireTasks->addIncoming(tasks1, cont);
+    retireTasks->addIncoming(tasks, cleanup);
+    Value *head = builder.CreateLoad(winHead);
+    Value *tail = builder.CreateLoad(winTail);
+    builder.CreateCondBr(builder.CreateICmpSLT(head, tail), retireCheck,
+                         retireExit);
+
+    builder.SetInsertPoint(retireCheck);
+    Value *slot = builder.CreateAnd(head, builder.getInt64(W - 1));
+    Value *flag = builder.CreateGEP(winDone, slot);
+    Value *full = builder.CreateICmpSGE(builder.CreateSub(tail, head),
+                                        builder.getInt64(W));
+    Value *must = builder.CreateOr(retireLast, full);
+    Value *ready = builder.CreateCall(readyFunc, flag);
+    builder.CreateCondBr(builder.CreateOr(must, ready), retireChunk,
+                         retireExit);
+
+    builder.SetInsertPoint(retireChunk);
+    builder.CreateCall(waitFunc, flag);
+    Value *outSlot = builder.CreateGEP(winOut, slot);
+    Value *retOut = builder.CreateLoad(outSlot);
+    Value *retLen = builder.CreateLoad(builder.CreateGEP(winLen, slot));
+    builder.CreateStore(nullOutBuf, outSlot);
+
+    BasicBlock *serialLoop = BasicBlock::Create(context, "ordered", func);
+    BasicBlock *serialBody = BasicBlock::Create(context, "ordered_body", func);
+    BasicBlock *serialDone = BasicBlock::Create(context, "ordered_done", func);
+    builder.CreateBr(serialLoop);
+
+    builder.SetInsertPoint(serialLoop);
+    PHINode *j = builder.CreatePHI(seqIntLLVM(context), 2);
+    j->addIncoming(zeroLLVM(context), retireChunk);
+    builder.CreateCondBr(builder.CreateICmpSLT(j, retLen), serialBody,
+                         serialDone);
+
+    builder.SetInsertPoint(serialBody);
+    state.block = serialBody;
+    state.type = outType;
+    state.val =
+        hasOut ? builder.CreateLoad(builder.CreateGEP(retOut, j)) : nullptr;
+
+    // save and restore state to codegen next stage
+    bool oldInLoop = state.inLoop;
+    bool oldInParallel = state.inParallel;
+    state.inLoop = true;
+    state.inParallel = false;
+    codegenPipe(base, state);
+    state.inLoop = oldInLoop;
+    state.inParallel = oldInParallel;
+
+    builder.SetInsertPoint(state.block);
+    j->addIncoming(builder.CreateAdd(j, oneLLVM(context)), state.block);
+    builder.CreateBr(serialLoop);
+
+    builder.SetInsertPoint(serialDone);
+    builder.CreateStore(builder.CreateAdd(head, oneLLVM(context)), winHead);
+    builder.CreateBr(retire);
+    retireLast->addIncoming(retireLast, serialDone);
+    retireTasks->addIncoming(retireTasks, serialDone);
+
+    next = retireExit;
+    tasks1 = retireTasks;
+    builder.SetInsertPoint(retireExit);
+    builder.CreateCondBr(retireLast, finish, loop0);
+  } else {
+    builder.CreateCondBr(last, finish, loop0);
+  }
+
+  buf->addIncoming(nullBuf, next);
+  out->addIncoming(nullOutBuf, next);
+  len->addIncoming(zeroLLVM(context), next);
+  cap->addIncoming(zeroLLVM(context), next);
+  tasks->addIncoming(tasks1, next);
+
+  genType->destroy(gen, finish);
+  BasicBlock *exit = BasicBlock::Create(context, "exit", func);
+  builder.SetInsertPoint(finish);
+  builder.CreateBr(exit);
+  state.block = exit;
+  return nullptr;
+}
+#endif /* SEQ_HAS_TAPIR */
+
+/*
+ * Drain step after prefetch or inter-align transformation: complete any
+ * calls still in flight and send their results through the remaining
+ * pipeline stages.
+ */
+void PipeExpr::codegenDrain(BaseFunc *base,
+                            PipeExpr::PipelineCodegenState &state) {
+  BasicBlock *block = state.block;
+  LLVMContext &context = block->getContext();
+  Module *module = block->getModule();
+  Function *func = block->getParent();
+  TryCatch *tc = getTryCatch();
+  IRBuilder<> builder(block);
+
+  DrainState &drain = state.drain;
+  if (!drain.states)
+    return;
+
+  types::GenType *genType = drain.type;
+  Value *states = drain.states;
+  Value *filled = drain.filled;
+  Value *N = builder.CreateLoad(filled);
+  BasicBlock *loop = BasicBlock::Create(context, "drain", func);
+
+  if (genType->fromPrefetch()) {
+    BasicBlock *loop0 = loop;
+    builder.CreateBr(loop);
+
+    builder.SetInsertPoint(loop);
+    PHINode *control = builder.CreatePHI(seqIntLLVM(context), 3);
+    control->addIncoming(zeroLLVM(context), block);
+    Value *cond = builder.CreateICmpSLT(control, N);
+    BasicBlock *body = BasicBlock::Create(context, "body", func);
+    BasicBlock *exit = BasicBlock::Create(context, "exit", func);
+    builder.CreateCondBr(cond, body, exit);
+
+    builder.SetInsertPoint(body);
+    Value *genSlot = builder.CreateGEP(states, control);
+    Value *gen = builder.CreateLoad(genSlot);
+    Value *done = genType->done(gen, body);
+    Value *next = builder.CreateAdd(control, oneLLVM(context));
+
+    BasicBlock *notDone = BasicBlock::Create(context, "not_done", func);
+    builder.CreateCondBr(done, loop0, notDone);
+    control->addIncoming(next, body);
+
+    BasicBlock *notDoneLoop = BasicBlock::Create(context, "not_done_loop", func);
+    BasicBlock *notDoneLoop0 = notDoneLoop;
+
+    builder.SetInsertPoint(notDone);
+    builder.CreateBr(notDoneLoop);
+
+    if (tc) {
+      BasicBlock *normal = BasicBlock::Create(context, "normal", func);
+      BasicBlock *unwind = tc->getExceptionBlock();
+      genType->resume(gen, notDoneLoop, normal, unwind);
+      notDoneLoop = normal;
+    } else {
+      genType->resume(gen, notDoneLoop, nullptr, nullptr);
+    }
+
+    BasicBlock *finalize = BasicBlock::Create(context, "finalize_gen", func);
+    done = genType->done(gen, notDoneLoop);
+    builder.SetInsertPoint(notDoneLoop);
+    builder.CreateCondBr(done, finalize, notDoneLoop0);
+
+    Value *val = genType->promise(gen, finalize);
+    PipeExpr::PipelineCodegenState drainState =
+        state.getDrainState(val, genType->getBaseType(0), finalize);
+    codegenPipe(base, drainState);
+    finalize = drainState.block;
+    genType->destroy(gen, finalize);
+    builder.SetInsertPoint(finalize);
+    builder.CreateBr(loop0);
+    control->addIncoming(next, finalize);
+
+    block = exit;
+  } else if (genType->fromInterAlign()) {
+    Func *flushFunc = Func::getBuiltin("_interaln_flush");
+    Function *flush = flushFunc->getFunc(module);
+
+    Value *cond = builder.CreateICmpSGT(N, builder.getInt64(0));
+    BasicBlock *exit = BasicBlock::Create(context, "exit", func);
+    builder.CreateCondBr(cond, loop, exit);
+
+    builder.SetInsertPoint(loop);
+    N = builder.CreateCall(flush, {drain.pairs, drain.bufRef, drain.bufQer,
+                                   states, N, drain.params, drain.hist,
+                                   drain.pairsTemp, drain.statesTemp});
+    builder.CreateStore(N, filled);
+    cond = builder.CreateICmpSGT(N, builder.getInt64(0));
+    builder.CreateCondBr(cond, loop, exit); // keep flushing while not empty
+
+    block = exit;
+  } else {
+    assert(0);
+  }
+
+  state.block = block;
+}
+
 Value *PipeExpr::codegen0(BaseFunc *base, BasicBlock *&block) {
   LLVMContext &context = block->getContext();
   Module *module = block->getModule();
@@ -694,11 +1282,18 @@ Value *PipeExpr::codegen0(BaseFunc *base, BasicBlock *&block) {
 
   std::vector<Expr *> stages(this->stages);
   std::vector<bool> parallel(this->parallel);
-  applyRevCompOptimization(stages, parallel);
-  applyCanonicalKmerOptimization(stages, parallel);
+  std::vector<bool> ordered(this->ordered);
+  applyRevCompOptimization(stages, parallel, ordered);
+  applyCanonicalKmerOptimization(stages, parallel, ordered);
+  validateOrdered(stages, parallel, ordered);
+
+  // a serial pipeline keeps items in order anyway
+  if (!SEQ_HAS_TAPIR || unparallelize)
+    std::fill(ordered.begin(), ordered.end(), false);
 
   std::queue<Expr *> queue;
   std::queue<bool> parallelQueue;
+  std::queue<bool> orderedQueue;
 
   for (auto *stage : stages)
     queue.push(stage);
@@ -706,6 +1301,9 @@ Value *PipeExpr::codegen0(BaseFunc *base, BasicBlock *&block) {
   for (bool parallelize : parallel)
     parallelQueue.push(parallelize && !unparallelize);
 
+  for (bool order : ordered)
+    orderedQueue.push(order);
+
   entry = block;
   IRBuilder<> builder(entry);
 
@@ -719,7 +1317,8 @@ Value *PipeExpr::codegen0(BaseFunc *base, BasicBlock *&block) {
   block = start;
 
   TryCatch *tc = getTryCatch();
-  PipeExpr::PipelineCodegenState state(block, queue, parallelQueue);
+  PipeExpr::PipelineCodegenState state(block, queue, parallelQueue,
+                                       orderedQueue);
 
 #if SEQ_HAS_TAPIR
   // If we have nested parallelism, make sure we use a task group
@@ -755,93 +1354,8 @@ Value *PipeExpr::codegen0(BaseFunc *base, BasicBlock *&block) {
 #endif
 
   Value *result = codegenPipe(base, state);
+  codegenDrain(base, state);
   block = state.block;
-  builder.SetInsertPoint(block);
-
-  DrainState &drain = state.drain;
-  if (drain.states) {
-    // drain step:
-    types::GenType *genType = drain.type;
-    Value *states = drain.states;
-    Value *filled = drain.filled;
-    Value *N = builder.CreateLoad(filled);
-    BasicBlock *loop = BasicBlock::Create(context, "drain", func);
-
-    if (genType->fromPrefetch()) {
-      BasicBlock *loop0 = loop;
-      builder.CreateBr(loop);
-
-      builder.SetInsertPoint(loop);
-      PHINode *control = builder.CreatePHI(seqIntLLVM(context), 3);
-      control->addIncoming(zeroLLVM(context), block);
-      Value *cond = builder.CreateICmpSLT(control, N);
-      BasicBlock *body = BasicBlock::Create(context, "body", func);
-      BasicBlock *exit = BasicBlock::Create(context, "exit", func);
-      builder.CreateCondBr(cond, body, exit);
-
-      builder.SetInsertPoint(body);
-      Value *genSlot = builder.CreateGEP(states, control);
-      Value *gen = builder.CreateLoad(genSlot);
-      Value *done = genType->done(gen, body);
-      Value *next = builder.CreateAdd(control, oneLLVM(context));
-
-      BasicBlock *notDone = BasicBlock::Create(context, "not_done", func);
-      builder.CreateCondBr(done, loop0, notDone);
-      control->addIncoming(next, body);
-
-      BasicBlock *notDoneLoop =
-          BasicBlock::Create(context, "not_done_loop", func);
-      BasicBlock *notDoneLoop0 = notDoneLoop;
-
-      builder.SetInsertPoint(notDone);
-      builder.CreateBr(notDoneLoop);
-
-      if (tc) {
-        BasicBlock *normal = BasicBlock::Create(context, "normal", func);
-        BasicBlock *unwind = tc->getExceptionBlock();
-        genType->resume(gen, notDoneLoop, normal, unwind);
-        notDoneLoop = normal;
-      } else {
-        genType->resume(gen, notDoneLoop, nullptr, nullptr);
-      }
-
-      BasicBlock *finalize = BasicBlock::Create(context, "finalize_gen", func);
-      done = genType->done(gen, notDoneLoop);
-      builder.SetInsertPoint(notDoneLoop);
-      builder.CreateCondBr(done, finalize, notDoneLoop0);
-
-      Value *val = genType->promise(gen, finalize);
-      PipeExpr::PipelineCodegenState drainState =
-          state.getDrainState(val, genType->getBaseType(0), finalize);
-      codegenPipe(base, drainState);
-      finalize = drainState.block;
-      genType->destroy(gen, finalize);
-      builder.SetInsertPoint(finalize);
-      builder.CreateBr(loop0);
-      control->addIncoming(next, finalize);
-
-      block = exit;
-    } else if (genType->fromInterAlign()) {
-      Func *flushFunc = Func::getBuiltin("_interaln_flush");
-      Function *flush = flushFunc->getFunc(module);
-
-      Value *cond = builder.CreateICmpSGT(N, builder.getInt64(0));
-      BasicBlock *exit = BasicBlock::Create(context, "exit", func);
-      builder.CreateCondBr(cond, loop, exit);
-
-      builder.SetInsertPoint(loop);
-      N = builder.CreateCall(flush, {drain.pairs, drain.bufRef, drain.bufQer,
-                                     states, N, drain.params, drain.hist,
-                                     drain.pairsTemp, drain.statesTemp});
-      builder.CreateStore(N, filled);
-      cond = builder.CreateICmpSGT(N, builder.getInt64(0));
-      builder.CreateCondBr(cond, loop, exit); // keep flushing while not empty
-
-      block = exit;
-    } else {
-      assert(0);
-    }
-  }
 
 #if SEQ_HAS_TAPIR
   builder.SetInsertPoint(block);
@@ -888,7 +1402,7 @@ PipeExpr *PipeExpr::clone(Generic *ref) {
   std::vector<Expr *> stagesCloned;
   for (auto *stage : stages)
     stagesCloned.push_back(stage->clone(ref));
-  SEQ_RETURN_CLONE(new PipeExpr(stagesCloned, parallel));
+  SEQ_RETURN_CLONE(new PipeExpr(stagesCloned, parallel, ordered));
 }
 
 types::RecordType *PipeExpr::getInterAlignYieldType() {
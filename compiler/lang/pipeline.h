@@ -9,18 +9,26 @@ class PipeExpr : public Expr {
 private:
   std::vector<Expr *> stages;
   std::vector<bool> parallel;
+  std::vector<bool> ordered;
   llvm::BasicBlock *entry;
   llvm::Value *syncReg;
 
   struct PipelineCodegenState;
   llvm::Value *codegenPipe(BaseFunc *base, PipelineCodegenState &state);
+  void codegenDrain(BaseFunc *base, PipelineCodegenState &state);
+  llvm::Value *codegenParallelLoop(BaseFunc *base,
+                                   PipelineCodegenState &state,
+                                   types::GenType *genType);
 
 public:
   static const unsigned SCHED_WIDTH_PREFETCH = 16;
   static const unsigned SCHED_WIDTH_INTERALIGN = 2048;
+  static const unsigned SCHED_WIDTH_ORDERED = 64;
   explicit PipeExpr(std::vector<Expr *> stages,
-                    std::vector<bool> parallel = {});
+                    std::vector<bool> parallel = {},
+                    std::vector<bool> ordered = {});
   void setParallel(unsigned which);
+  void setOrdered(unsigned which);
   void resolveTypes() override;
   llvm::Value *codegen0(BaseFunc *base, llvm::BasicBlock *&block) override;
   types::Type *getType0() const override;
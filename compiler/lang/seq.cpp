@@ -15,7 +15,8 @@ using namespace llvm::orc;
 #include "llvm/CodeGen/CommandFlags.def"
 #endif
 
-config::Config::Config() : context(), debug(false), profile(false) {}
+config::Config::Config()
+    : context(), debug(false), profile(false), pipelineChunk(0) {}
 
 config::Config &seq::config::config() {
   static Config config;
@@ -43,6 +43,7 @@ struct Config {
   llvm::LLVMContext context;
   bool debug;
   bool profile;
+  int pipelineChunk; // max items per parallel pipeline task; 0 = runtime
 
   Config();
 };
@@ -298,6 +298,8 @@ void CodegenExprVisitor::visit(const PipeExpr *expr) {
   for (int i = 0; i < expr->items.size(); i++) {
     if (expr->items[i].op == "||>") {
       pexpr->setParallel(i);
+    } else if (expr->items[i].op == ">|") {
+      pexpr->setOrdered(i);
     }
   }
   this->result = pexpr;
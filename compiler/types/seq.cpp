@@ -460,15 +460,28 @@ static Function *getInitFunc(types::KMer *kmerType, Module *module,
       kmer = builder.CreateOr(kmer, shift);
     }
 
-    Value *kmerRC =
-        kmerType->callMagic("__invert__", {}, kmer, {}, block, nullptr);
     if (!rcVal) {
       Value *len = types::Seq->memb(seq, "len", block);
       rcVal = builder.CreateICmpSLT(len, zeroLLVM(context));
     } else {
       rcVal = builder.CreateZExtOrTrunc(rcVal, IntegerType::getInt1Ty(context));
     }
-    builder.CreateRet(builder.CreateSelect(rcVal, kmerRC, kmer));
+
+    // branch rather than select, so that forward k-mers (the common case)
+    // don't pay for a reverse complement that is then discarded
+    BasicBlock *rcBlock = BasicBlock::Create(context, "rc", func);
+    BasicBlock *exit = BasicBlock::Create(context, "exit", func);
+    builder.CreateCondBr(rcVal, rcBlock, exit);
+    Value *kmerRC =
+        kmerType->callMagic("__invert__", {}, kmer, {}, rcBlock, nullptr);
+    builder.SetInsertPoint(rcBlock);
+    builder.CreateBr(exit);
+
+    builder.SetInsertPoint(exit);
+    PHINode *result = builder.CreatePHI(kmerType->getLLVMType(context), 2);
+    result->addIncoming(kmer, block);
+    result->addIncoming(kmerRC, rcBlock);
+    builder.CreateRet(result);
   }
 
   return func;
@@ -607,6 +620,38 @@ static Value *codegenRevCompByLookup(types::KMer *kmerType, Value *self,
   return result;
 }
 
+// Byte-swaps the complemented k-mer (padded to a multiple of 16 bits, as
+// required by llvm.bswap), then reverses the four 2-bit bases within each
+// byte with two mask-and-shift steps. Up to k=32 this is a handful of
+// scalar instructions, with no table loads.
+static Value *codegenRevCompByByteSwap(types::KMer *kmerType, Value *self,
+                                       IRBuilder<> &b) {
+  const unsigned k = kmerType->getK();
+  LLVMContext &context = b.getContext();
+  Module *module = b.GetInsertBlock()->getModule();
+  const unsigned w = ((2 * k + 15) / 16) * 16;
+
+  llvm::Type *ty = IntegerType::get(context, w);
+  Value *result = b.CreateZExt(b.CreateNot(self), ty);
+  Function *bswap = Intrinsic::getDeclaration(module, Intrinsic::bswap, {ty});
+  result = b.CreateCall(bswap, result);
+
+  const uint8_t masks[] = {0x0f, 0x33};
+  const unsigned shifts[] = {4, 2};
+  for (unsigned i = 0; i < 2; i++) {
+    Value *mask = ConstantInt::get(ty, APInt::getSplat(w, APInt(8, masks[i])));
+    Value *r1 = b.CreateAnd(b.CreateLShr(result, shifts[i]), mask);
+    Value *r2 = b.CreateShl(b.CreateAnd(result, mask), shifts[i]);
+    result = b.CreateOr(r1, r2);
+  }
+
+  if (w != 2 * k) {
+    assert(w > 2 * k);
+    result = b.CreateLShr(result, w - (2 * k));
+  }
+  return b.CreateZExtOrTrunc(result, kmerType->getLLVMType(context));
+}
+
 static Value *codegenRevCompBySIMD(types::KMer *kmerType, Value *self,
                                    IRBuilder<> &b) {
   const unsigned k = kmerType->getK();
@@ -764,14 +809,14 @@ void types::KMer::initOps() {
        this,
        [this](Value *self, std::vector<Value *> args, IRBuilder<> &b) {
          // The following are heuristics found to be roughly optimal on
-         // several architectures. For smaller k, lookup is almost always
-         // better. For larger k, SIMD is almost always better. For medium k,
-         // it varies based on whether k is a power of 2, but bitwise is
-         // almost always close to (if not) the best.
-         if (k <= 20) {
+         // several architectures. For small k, a single table lookup is
+         // best. Up to k=32, byte-swapping a machine word beats both the
+         // per-byte lookups and the log(k) shift steps of the bitwise
+         // method. For larger k, SIMD is almost always better.
+         if (k <= 4) {
            return codegenRevCompByLookup(this, self, b);
-         } else if (k < 32) {
-           return codegenRevCompByBitShift(this, self, b);
+         } else if (k <= 32) {
+           return codegenRevCompByByteSwap(this, self, b);
          } else {
            return codegenRevCompBySIMD(this, self, b);
          }
@@ -794,6 +839,14 @@ void types::KMer::initOps() {
        },
        false},
 
+      {"__rc_bswap__",
+       {},
+       this,
+       [this](Value *self, std::vector<Value *> args, IRBuilder<> &b) {
+         return codegenRevCompByByteSwap(this, self, b);
+       },
+       false},
+
       {"__rc_simd__",
        {},
        this,
@@ -0,0 +1,142 @@
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "lib.h"
+
+/*
+ * FMD-index occurrence counting
+ *
+ * The FMD-index stores its BWT in BWA's interleaved layout: every interval
+ * of 128 bases starts with the four 64-bit occurrence counts up to the
+ * interval, followed by the bases themselves, 2 bits each and most
+ * significant first, in eight 32-bit words. Counting the occurrences of
+ * each base up to position k therefore only needs to look at one 32-byte
+ * block of bases.
+ *
+ * The bases after k are masked to zero (i.e. 'A'), so C/G/T are counted
+ * directly and A is derived from the number of bases that were kept. The
+ * kernel is picked once, based on the CPU: AVX2 counts the whole block in
+ * vector registers, otherwise the block is counted 64 bits at a time with
+ * (hardware, if available) popcount.
+ */
+
+typedef void (*occ4_fn_t)(const uint32_t *, seq_int_t, seq_int_t *);
+
+template <typename PopCount>
+static inline void occ4_words(const uint32_t *p, seq_int_t r, seq_int_t *cnt,
+                              PopCount popcount) {
+  const uint32_t *b = p + 8;
+  seq_int_t c1 = 0, c2 = 0, c3 = 0;
+  for (int j = 0; j < 8; j += 2) {
+    uint64_t w = (uint64_t)b[j] << 32 | b[j + 1];
+    seq_int_t n = r + 1 - 16 * j; // bases to keep in w
+    if (n <= 0)
+      break;
+    if (n < 32)
+      w &= ~(~0ULL >> (2 * n));
+    const uint64_t hi = w >> 1 & 0x5555555555555555ULL;
+    const uint64_t lo = w & 0x5555555555555555ULL;
+    c1 += popcount(lo & ~hi);
+    c2 += popcount(hi & ~lo);
+    c3 += popcount(hi & lo);
+  }
+  seq_int_t base[4];
+  memcpy(base, p, sizeof(base));
+  cnt[0] = base[0] + (r + 1) - (c1 + c2 + c3);
+  cnt[1] = base[1] + c1;
+  cnt[2] = base[2] + c2;
+  cnt[3] = base[3] + c3;
+}
+
+static void occ4_generic(const uint32_t *p, seq_int_t r, seq_int_t *cnt) {
+  occ4_words(p, r, cnt, [](uint64_t x) { return __builtin_popcountll(x); });
+}
+
+#if defined(__x86_64__)
+__attribute__((target("popcnt"))) static void
+occ4_popcnt(const uint32_t *p, seq_int_t r, seq_int_t *cnt) {
+  occ4_words(p, r, cnt, [](uint64_t x) { return __builtin_popcountll(x); });
+}
+
+__attribute__((target("avx2"))) static inline __m256i popcount8(__m256i v) {
+  const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3,
+                                       3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3,
+                                       2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0f);
+  __m256i a = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+  __m256i b =
+      _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+  return _mm256_add_epi8(a, b);
+}
+
+__attribute__((target("avx2"))) static inline seq_int_t hsum64(__m256i v) {
+  __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v),
+                            _mm256_extracti128_si256(v, 1));
+  return (seq_int_t)(_mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1));
+}
+
+__attribute__((target("avx2"))) static void
+occ4_avx2(const uint32_t *p, seq_int_t r, seq_int_t *cnt) {
+  const __m256i w =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 8));
+  // word j keeps its first min(max(r + 1 - 16j, 0), 16) bases; shifting by
+  // 32 or more clears a lane entirely
+  const __m256i kept = _mm256_min_epi32(
+      _mm256_max_epi32(
+          _mm256_sub_epi32(_mm256_set1_epi32((int)r + 1),
+                           _mm256_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112)),
+          _mm256_setzero_si256()),
+      _mm256_set1_epi32(16));
+  const __m256i shift =
+      _mm256_sub_epi32(_mm256_set1_epi32(32), _mm256_slli_epi32(kept, 1));
+  const __m256i x =
+      _mm256_and_si256(w, _mm256_sllv_epi32(_mm256_set1_epi32(-1), shift));
+  const __m256i m = _mm256_set1_epi32(0x55555555);
+  const __m256i hi = _mm256_and_si256(_mm256_srli_epi32(x, 1), m);
+  const __m256i lo = _mm256_and_si256(x, m);
+  const __m256i zero = _mm256_setzero_si256();
+  seq_int_t c1 = hsum64(
+      _mm256_sad_epu8(popcount8(_mm256_andnot_si256(hi, lo)), zero));
+  seq_int_t c2 = hsum64(
+      _mm256_sad_epu8(popcount8(_mm256_andnot_si256(lo, hi)), zero));
+  seq_int_t c3 =
+      hsum64(_mm256_sad_epu8(popcount8(_mm256_and_si256(hi, lo)), zero));
+  seq_int_t base[4];
+  memcpy(base, p, sizeof(base));
+  cnt[0] = base[0] + (r + 1) - (c1 + c2 + c3);
+  cnt[1] = base[1] + c1;
+  cnt[2] = base[2] + c2;
+  cnt[3] = base[3] + c3;
+}
+#endif
+
+static occ4_fn_t occ4_select() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return occ4_avx2;
+  if (__builtin_cpu_supports("popcnt"))
+    return occ4_popcnt;
+#endif
+  return occ4_generic;
+}
+
+static const occ4_fn_t occ4_impl = occ4_select();
+
+/*
+ * Occurrences of each base up to and including position r of the interval
+ * starting at p, plus the counts stored for the interval.
+ */
+SEQ_FUNC void seq_fmd_occ4(const uint32_t *p, seq_int_t r, seq_int_t *cnt) {
+  occ4_impl(p, r, cnt);
+}
+
+SEQ_FUNC void seq_fmd_2occ4(const uint32_t *p, seq_int_t rk, seq_int_t rl,
+                            seq_int_t *cntk, seq_int_t *cntl) {
+  occ4_impl(p, rk, cntk);
+  occ4_impl(p, rl, cntl);
+}
@@ -0,0 +1,443 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+#include "lib.h"
+
+using namespace std;
+
+/*
+ * Read-ahead reader
+ *
+ * Background threads pull large chunks from the underlying file into a
+ * bounded, ordered queue, so that I/O and inflation overlap with parsing on
+ * the calling thread. The stdlib parsers only ever see plain bytes via
+ * seq_reader_read().
+ *
+ * BGZF input (as produced by bgzip/htslib) consists of independent gzip
+ * members of at most 64KB each, so blocks are grouped into jobs and inflated
+ * on a pool of worker threads. Any other gzip input, including multi-member
+ * files, has no member index to split on and is instead inflated through
+ * zlib on a single read-ahead thread.
+ *
+ * Background threads are not registered with the GC and must not allocate
+ * GC memory; chunks are malloc'd and copied out on the consumer side.
+ * Closing a reader stops and joins its threads. The stdlib closes readers
+ * when done with them, or else when their file object is collected (e.g.
+ * after a loop over records exits early).
+ */
+
+namespace {
+atomic<seq_int_t> openReaders(0);
+
+struct Chunk {
+  char *data;
+  size_t len;
+};
+
+struct Job {
+  uint64_t id;
+  char *data;
+  size_t len;
+  size_t outLen;
+};
+
+const unsigned BGZF_HEADER_SIZE = 18;
+const unsigned BGZF_MAX_BLOCK_SIZE = 0x10000;
+
+inline unsigned le16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+
+inline uint32_t le32(const unsigned char *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+// Returns the total size of the BGZF block starting with the given header
+// (i.e. BSIZE + 1), or 0 if the header is not that of a BGZF block.
+unsigned bgzfBlockSize(const unsigned char *h, size_t n) {
+  if (n < 12 || h[0] != 31 || h[1] != 139 || h[2] != 8 || !(h[3] & 4))
+    return 0;
+  const unsigned xlen = le16(&h[10]);
+  if (12 + xlen > n)
+    return 0;
+  // look for the "BC" subfield holding BSIZE
+  for (unsigned i = 12; i + 4 <= 12 + xlen;) {
+    const unsigned slen = le16(&h[i + 2]);
+    if (h[i] == 'B' && h[i + 1] == 'C' && slen == 2 && i + 6 <= 12 + xlen)
+      return le16(&h[i + 4]) + 1;
+    i += 4 + slen;
+  }
+  return 0;
+}
+
+class Reader {
+private:
+  FILE *fp;
+  gzFile gz;
+  bool bgzf;
+  size_t chunkSize;
+  uint64_t maxInFlight;
+
+  mutex m;
+  condition_variable cvReady;
+  condition_variable cvSpace;
+  condition_variable cvJobs;
+  deque<Job> jobs;
+  map<uint64_t, Chunk> ready;
+  uint64_t nextId;
+  uint64_t nextOut;
+  uint64_t endId;
+  bool readerDone;
+  bool stop;
+  string err;
+  vector<thread> threads;
+
+  Chunk cur;
+  size_t pos;
+
+  void fail(const string &msg) {
+    lock_guard<mutex> lock(m);
+    if (err.empty())
+      err = msg;
+  }
+
+  // reserves the next chunk ID, or returns false if the reader is closing
+  bool reserve(uint64_t &id) {
+    unique_lock<mutex> lock(m);
+    cvSpace.wait(lock,
+                 [this] { return stop || nextId - nextOut < maxInFlight; });
+    if (stop)
+      return false;
+    id = nextId++;
+    return true;
+  }
+
+  // marks the end of the stream; on error, data before the failing chunk
+  // is still delivered
+  void finish(uint64_t id, bool reader = true) {
+    lock_guard<mutex> lock(m);
+    endId = min(endId, id);
+    if (reader)
+      readerDone = true;
+    cvReady.notify_all();
+    cvJobs.notify_all();
+  }
+
+  ssize_t readRaw(char *buf, size_t n) {
+    if (gz) {
+      int rd = gzread(gz, buf, (unsigned)n);
+      if (rd < 0) {
+        int errnum = 0;
+        const char *msg = gzerror(gz, &errnum);
+        fail(string("zlib error: ") + (msg ? msg : "unknown"));
+      }
+      return rd;
+    } else {
+      size_t rd = fread(buf, 1, n, fp);
+      if (rd < n && ferror(fp)) {
+        fail("error in read");
+        return -1;
+      }
+      return (ssize_t)rd;
+    }
+  }
+
+  void produce() {
+    while (true) {
+      uint64_t id;
+      if (!reserve(id))
+        return;
+      auto *data = (char *)malloc(chunkSize);
+      ssize_t n = readRaw(data, chunkSize);
+      if (n <= 0) {
+        free(data);
+        finish(id);
+        return;
+      }
+      lock_guard<mutex> lock(m);
+      ready[id] = {data, (size_t)n};
+      cvReady.notify_all();
+    }
+  }
+
+  // Reads whole BGZF blocks until their inflated size reaches the chunk
+  // size. Returns false on error; an empty job signals end of file.
+  bool readBlocks(Job &job) {
+    size_t cap = BGZF_MAX_BLOCK_SIZE;
+    job.data = (char *)malloc(cap);
+    job.len = 0;
+    job.outLen = 0;
+    while (job.outLen < chunkSize) {
+      unsigned char h[12];
+      size_t rd = fread(h, 1, sizeof(h), fp);
+      if (rd == 0 && !ferror(fp))
+        break;
+      if (rd < sizeof(h)) {
+        fail(ferror(fp) ? "error in read" : "truncated BGZF block");
+        return false;
+      }
+      const unsigned xlen = le16(&h[10]);
+      if (job.len + sizeof(h) + xlen > cap) {
+        cap = max(2 * cap, job.len + sizeof(h) + xlen);
+        job.data = (char *)realloc(job.data, cap);
+      }
+      auto *block = (unsigned char *)job.data + job.len;
+      memcpy(block, h, sizeof(h));
+      if (fread(block + sizeof(h), 1, xlen, fp) != xlen) {
+        fail("truncated BGZF block");
+        return false;
+      }
+      const unsigned size = bgzfBlockSize(block, sizeof(h) + xlen);
+      if (size < sizeof(h) + xlen + 8) {
+        fail("invalid BGZF block header");
+        return false;
+      }
+      if (job.len + size > cap) {
+        cap = max(2 * cap, job.len + size);
+        job.data = (char *)realloc(job.data, cap);
+        block = (unsigned char *)job.data + job.len;
+      }
+      const size_t rest = size - sizeof(h) - xlen;
+      if (fread(block + sizeof(h) + xlen, 1, rest, fp) != rest) {
+        fail("truncated BGZF block");
+        return false;
+      }
+      job.len += size;
+      job.outLen += le32(block + size - 4);
+    }
+    return true;
+  }
+
+  void produceBlocks() {
+    while (true) {
+      Job job;
+      if (!reserve(job.id))
+        return;
+      if (!readBlocks(job) || job.len == 0) {
+        free(job.data);
+        finish(job.id);
+        return;
+      }
+      lock_guard<mutex> lock(m);
+      jobs.push_back(job);
+      cvJobs.notify_one();
+    }
+  }
+
+  bool inflateBlocks(const Job &job, char *out) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -15) != Z_OK)
+      return false;
+    bool ok = true;
+    size_t outPos = 0;
+    for (size_t i = 0; ok && i < job.len;) {
+      auto *block = (unsigned char *)job.data + i;
+      const unsigned size = bgzfBlockSize(block, job.len - i);
+      const unsigned offset = 12 + le16(&block[10]);
+      const uint32_t crc = le32(&block[size - 8]);
+      const uint32_t isize = le32(&block[size - 4]);
+      zs.next_in = block + offset;
+      zs.avail_in = size - offset - 8;
+      zs.next_out = (unsigned char *)out + outPos;
+      zs.avail_out = isize;
+      ok = inflate(&zs, Z_FINISH) == Z_STREAM_END && zs.avail_out == 0 &&
+           crc32(crc32(0L, Z_NULL, 0), (unsigned char *)out + outPos,
+                 isize) == crc &&
+           inflateReset(&zs) == Z_OK;
+      outPos += isize;
+      i += size;
+    }
+    inflateEnd(&zs);
+    return ok;
+  }
+
+  void work() {
+    while (true) {
+      Job job;
+      {
+        unique_lock<mutex> lock(m);
+        cvJobs.wait(lock,
+                    [this] { return stop || readerDone || !jobs.empty(); });
+        if (stop || jobs.empty())
+          return;
+        job = jobs.front();
+        jobs.pop_front();
+      }
+      auto *out = (char *)malloc(max(job.outLen, (size_t)1));
+      const bool ok = inflateBlocks(job, out);
+      free(job.data);
+      if (!ok) {
+        free(out);
+        fail("BGZF block could not be inflated");
+        finish(job.id, /*reader=*/false);
+        continue;
+      }
+      lock_guard<mutex> lock(m);
+      ready[job.id] = {out, job.outLen};
+      cvReady.notify_all();
+    }
+  }
+
+public:
+  Reader(FILE *fp, gzFile gz, bool bgzf, size_t chunkSize, unsigned workers)
+      : fp(fp), gz(gz), bgzf(bgzf), chunkSize(chunkSize), maxInFlight(),
+        m(), cvReady(), cvSpace(), cvJobs(), jobs(), ready(), nextId(0),
+        nextOut(0), endId(UINT64_MAX), readerDone(false), stop(false), err(),
+        threads(), cur({nullptr, 0}), pos(0) {
+    ++openReaders;
+    if (bgzf) {
+      maxInFlight = workers + 2;
+      threads.emplace_back(&Reader::produceBlocks, this);
+      for (unsigned i = 0; i < workers; i++)
+        threads.emplace_back(&Reader::work, this);
+    } else {
+      maxInFlight = 4;
+      threads.emplace_back(&Reader::produce, this);
+    }
+  }
+
+  ~Reader() {
+    {
+      lock_guard<mutex> lock(m);
+      stop = true;
+    }
+    cvSpace.notify_all();
+    cvJobs.notify_all();
+    for (auto &t : threads)
+      t.join();
+    for (auto &job : jobs)
+      free(job.data);
+    for (auto &chunk : ready)
+      free(chunk.second.data);
+    free(cur.data);
+    if (gz)
+      gzclose(gz);
+    if (fp)
+      fclose(fp);
+    --openReaders;
+  }
+
+  seq_int_t read(char *buf, seq_int_t n) {
+    seq_int_t total = 0;
+    while (total < n) {
+      if (pos == cur.len) {
+        free(cur.data);
+        cur = {nullptr, 0};
+        pos = 0;
+        unique_lock<mutex> lock(m);
+        cvReady.wait(lock, [this] {
+          return nextOut >= endId || ready.count(nextOut);
+        });
+        auto it = ready.find(nextOut);
+        if (it == ready.end())
+          return (total == 0 && !err.empty()) ? -1 : total;
+        cur = it->second;
+        ready.erase(it);
+        ++nextOut;
+        cvSpace.notify_one();
+      }
+      size_t k = min((size_t)(n - total), cur.len - pos);
+      memcpy(buf + total, cur.data + pos, k);
+      pos += k;
+      total += (seq_int_t)k;
+    }
+    return total;
+  }
+
+  string error() {
+    lock_guard<mutex> lock(m);
+    return err;
+  }
+};
+} // namespace
+
+static const unsigned READER_MAX_AUTO_THREADS = 4;
+
+SEQ_FUNC void *seq_reader_open(const char *path, bool gzip,
+                               seq_int_t chunk_size, seq_int_t threads) {
+  if (chunk_size <= 0)
+    return nullptr;
+  FILE *fp = fopen(path, "r");
+  if (!fp)
+    return nullptr;
+  if (!gzip)
+    return new Reader(fp, nullptr, false, (size_t)chunk_size, 0);
+
+  unsigned char h[BGZF_HEADER_SIZE];
+  const size_t rd = fread(h, 1, sizeof(h), fp);
+  if (bgzfBlockSize(h, rd) && fseek(fp, 0, SEEK_SET) == 0) {
+    unsigned workers = (unsigned)threads;
+    if (threads <= 0)
+      workers = max(1u, min(READER_MAX_AUTO_THREADS,
+                            thread::hardware_concurrency()));
+    return new Reader(fp, nullptr, true, (size_t)chunk_size, workers);
+  }
+
+  fclose(fp);
+  gzFile gz = gzopen(path, "r");
+  if (!gz)
+    return nullptr;
+  gzbuffer(gz, 1 << 17);
+  return new Reader(nullptr, gz, false, (size_t)chunk_size, 0);
+}
+
+SEQ_FUNC seq_int_t seq_reader_read(void *reader, char *buf, seq_int_t n) {
+  return ((Reader *)reader)->read(buf, n);
+}
+
+SEQ_FUNC seq_str_t seq_reader_error(void *reader) {
+  string msg = ((Reader *)reader)->error();
+  if (msg.empty())
+    return {0, nullptr};
+  auto *buf = (char *)seq_alloc_atomic(msg.size());
+  memcpy(buf, msg.data(), msg.size());
+  return {(seq_int_t)msg.size(), buf};
+}
+
+SEQ_FUNC void seq_reader_close(void *reader) { delete (Reader *)reader; }
+
+// Number of readers opened and not yet closed.
+SEQ_FUNC seq_int_t seq_reader_count() { return openReaders; }
+
+/*
+ * File mapping
+ *
+ * Read-only shared mappings of whole files, used for random access into
+ * large reference data; pages come from the OS page cache and are shared
+ * by all processes mapping the same file.
+ */
+
+SEQ_FUNC void *seq_mmap_file(const char *path, seq_int_t *len) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size == 0) {
+    close(fd);
+    return nullptr;
+  }
+  void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return nullptr;
+  *len = (seq_int_t)st.st_size;
+  return p;
+}
+
+SEQ_FUNC void seq_munmap(void *p, seq_int_t len) { munmap(p, (size_t)len); }
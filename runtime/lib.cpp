@@ -1,4 +1,5 @@
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cerrno>
 #include <chrono>
@@ -42,6 +43,10 @@ typedef void (*kmpc_micro)(kmp_int32 *global_tid, kmp_int32 *bound_tid, ...);
 static ident_t dummy_loc = {0, 2, 0, 0, ";unknown;unknown;0;0;;"};
 extern "C" void __kmpc_fork_call(ident_t *, kmp_int32 nargs,
                                  kmpc_micro microtask, ...);
+extern "C" kmp_int32 __kmpc_global_thread_num(ident_t *);
+extern "C" kmp_int32 __kmpc_omp_taskyield(ident_t *, kmp_int32 gtid,
+                                          int end_part);
+extern "C" int omp_get_max_threads();
 static void register_thread(kmp_int32 *global_tid, kmp_int32 *bound_tid) {
   GC_stack_base sb;
   GC_get_stack_base(&sb);
@@ -59,6 +64,62 @@ SEQ_FUNC void seq_init() {
   seq_exc_init();
 }
 
+/*
+ * Parallel pipelines
+ */
+#define SEQ_PIPELINE_CHUNK_ENV_VAR "SEQ_PIPELINE_CHUNK"
+static const seq_int_t DEFAULT_PIPELINE_CHUNK = 64;
+
+static seq_int_t pipeline_chunk_limit() {
+  static const seq_int_t limit = [] {
+    const char *s = getenv(SEQ_PIPELINE_CHUNK_ENV_VAR);
+    if (!s || !*s)
+      return DEFAULT_PIPELINE_CHUNK;
+    char *end = nullptr;
+    long long n = strtoll(s, &end, 10);
+    if (*end || n <= 0) {
+      fprintf(stderr, "warning: ignoring invalid %s value '%s'\n",
+              SEQ_PIPELINE_CHUNK_ENV_VAR, s);
+      return DEFAULT_PIPELINE_CHUNK;
+    }
+    return (seq_int_t)n;
+  }();
+  return limit;
+}
+
+// Number of items to batch into the next task of a parallel ("||>")
+// pipeline stage that has already spawned `tasks` tasks. `limit` is the
+// maximum chunk size set at compile time, or 0 to use the environment.
+SEQ_FUNC seq_int_t seq_pipeline_chunk_size(seq_int_t tasks, seq_int_t limit) {
+  if (limit <= 0)
+    limit = pipeline_chunk_limit();
+  const seq_int_t threads = omp_get_max_threads();
+  if (tasks < threads)
+    return 1;
+  const seq_int_t shift = tasks - threads + 1;
+  return shift >= 32 ? limit : min(limit, (seq_int_t)1 << shift);
+}
+
+// Completion flags of the chunks of an ordered (">|") parallel pipeline:
+// set by the task that processed the chunk, and checked by the thread that
+// passes chunk outputs on in order. Waiting yields to other tasks, which
+// may include the one processing the awaited chunk.
+SEQ_FUNC void seq_pipeline_chunk_done(seq_int_t *flag) {
+  __atomic_store_n(flag, 1, __ATOMIC_RELEASE);
+}
+
+SEQ_FUNC bool seq_pipeline_chunk_ready(seq_int_t *flag) {
+  return __atomic_load_n(flag, __ATOMIC_ACQUIRE) != 0;
+}
+
+SEQ_FUNC void seq_pipeline_chunk_wait(seq_int_t *flag) {
+  if (seq_pipeline_chunk_ready(flag))
+    return;
+  const kmp_int32 gtid = __kmpc_global_thread_num(&dummy_loc);
+  while (!seq_pipeline_chunk_ready(flag))
+    __kmpc_omp_taskyield(&dummy_loc, gtid, 0);
+}
+
 SEQ_FUNC seq_int_t seq_pid() { return (seq_int_t)getpid(); }
 
 SEQ_FUNC seq_int_t seq_time() {
@@ -168,6 +229,13 @@ SEQ_FUNC void seq_gc_exclude_static_roots(void *start, void *end) {
 #endif
 }
 
+SEQ_FUNC void seq_gc_collect() {
+#if !USE_STANDARD_MALLOC
+  GC_gcollect();
+  GC_invoke_finalizers();
+#endif
+}
+
 /*
  * String conversion
  */
@@ -291,6 +359,18 @@ SEQ_FUNC void seq_rlock_release(void *lock) {
   m->unlock();
 }
 
+// Small number identifying the calling OS thread, assigned on its first
+// call. Unlike omp_get_thread_num(), it differs between threads of nested
+// (serialized) parallel regions and for threads not started by OpenMP.
+static std::atomic<seq_int_t> thread_slots(0);
+
+SEQ_FUNC seq_int_t seq_thread_slot() {
+  static thread_local seq_int_t slot = -1;
+  if (slot < 0)
+    slot = thread_slots.fetch_add(1, std::memory_order_relaxed);
+  return slot;
+}
+
 /*
  * Alignment
  *
@@ -438,6 +518,108 @@ SEQ_FUNC void seq_align_global(seq_t query, seq_t target, int8_t *mat,
   *out = {{backtrace ? cigar : nullptr, backtrace ? n_cigar : 0}, score};
 }
 
+/*
+ * Aligners align one query against many targets. The query is encoded, and
+ * the score matrix and options are set up, once; the DP buffers of every
+ * alignment come from a scratch arena that is kept between alignments, and
+ * the targets are encoded into a buffer that is kept too, so aligning does
+ * not allocate beyond the CIGARs returned. Not safe to share across threads.
+ */
+enum { SEQ_ALIGN_REGULAR, SEQ_ALIGN_DUAL, SEQ_ALIGN_SPLICE, SEQ_ALIGN_GLOBAL };
+
+struct SeqAligner {
+  ksw_km_t km;
+  uint8_t *query;
+  int qlen;
+  uint8_t *target;
+  int tcap;
+  int8_t mat[25];
+  int kind;
+  int8_t gapo, gape, gapo2, gape2;
+  int bandwidth, zdrop, end_bonus, flags;
+};
+
+SEQ_FUNC SeqAligner *seq_aligner_new(seq_t query, int8_t *mat, int8_t gapo,
+                                     int8_t gape, int8_t gapo2, int8_t gape2,
+                                     seq_int_t bandwidth, seq_int_t zdrop,
+                                     seq_int_t end_bonus, seq_int_t flags,
+                                     seq_int_t kind) {
+  auto *aligner = (SeqAligner *)calloc(1, sizeof(SeqAligner));
+  if (!aligner)
+    return nullptr;
+  aligner->qlen = (int)abs(query.len);
+  aligner->query = (uint8_t *)malloc(aligner->qlen ? aligner->qlen : 1);
+  if (!aligner->query) {
+    free(aligner);
+    return nullptr;
+  }
+  encode(query, aligner->query);
+  memcpy(aligner->mat, mat, sizeof(aligner->mat));
+  aligner->kind = (int)kind;
+  aligner->gapo = gapo;
+  aligner->gape = gape;
+  aligner->gapo2 = gapo2;
+  aligner->gape2 = gape2;
+  aligner->bandwidth = (int)bandwidth;
+  aligner->zdrop = (int)zdrop;
+  aligner->end_bonus = (int)end_bonus;
+  aligner->flags = (int)flags;
+  return aligner;
+}
+
+// Returns false, leaving the aligner as it was, if the target cannot be
+// buffered.
+SEQ_FUNC bool seq_aligner_align(SeqAligner *a, seq_t target, Alignment *out) {
+  const int tlen = (int)abs(target.len);
+  if (tlen > a->tcap) {
+    const int tcap = tlen > 2 * a->tcap ? tlen : 2 * a->tcap;
+    auto *buf = (uint8_t *)malloc(tcap);
+    if (!buf)
+      return false;
+    free(a->target);
+    a->target = buf;
+    a->tcap = tcap;
+  }
+  encode(target, a->target);
+
+  ksw_extz_t ez;
+  switch (a->kind) {
+  case SEQ_ALIGN_REGULAR:
+    ksw_extz2_sse(&a->km, a->qlen, a->query, tlen, a->target, 5, a->mat,
+                  a->gapo, a->gape, a->bandwidth, a->zdrop, a->end_bonus,
+                  a->flags, &ez);
+    break;
+  case SEQ_ALIGN_DUAL:
+    ksw_extd2_sse(&a->km, a->qlen, a->query, tlen, a->target, 5, a->mat,
+                  a->gapo, a->gape, a->gapo2, a->gape2, a->bandwidth,
+                  a->zdrop, a->end_bonus, a->flags, &ez);
+    break;
+  case SEQ_ALIGN_SPLICE:
+    ksw_exts2_sse(&a->km, a->qlen, a->query, tlen, a->target, 5, a->mat,
+                  a->gapo, a->gape, a->gapo2, a->gape2, a->zdrop, a->flags,
+                  &ez);
+    break;
+  default: {
+    ksw_reset_extz(&ez);
+    ez.score = ksw_gg2_sse(&a->km, a->qlen, a->query, tlen, a->target, 5,
+                           a->mat, a->gapo, a->gape, a->bandwidth,
+                           &ez.m_cigar, &ez.n_cigar, &ez.cigar);
+    break;
+  }
+  }
+  ksw_km_reset(&a->km);
+  *out = {{ez.cigar, ez.n_cigar},
+          a->flags & KSW_EZ_EXTZ_ONLY ? ez.max : ez.score};
+  return true;
+}
+
+SEQ_FUNC void seq_aligner_free(SeqAligner *aligner) {
+  ksw_km_destroy(&aligner->km);
+  free(aligner->query);
+  free(aligner->target);
+  free(aligner);
+}
+
 SEQ_FUNC void seq_palign(seq_t query, seq_t target, int8_t *mat, int8_t gapo,
                          int8_t gape, seq_int_t bandwidth, seq_int_t zdrop,
                          seq_int_t end_bonus, seq_int_t flags, Alignment *out) {
@@ -530,9 +712,23 @@ typedef struct __kstring_t {
   char *s;
 } kstring_t;
 
+// leading values of htslib's htsExactFormat, in hts.h's order
+enum htsExactFormat {
+  unknown_format,
+  binary_format,
+  text_format,
+  sam,
+  bam,
+  bai,
+  cram,
+  crai,
+  vcf,
+  bcf,
+};
+
 typedef struct htsFormat {
   int32_t category;
-  int32_t format;
+  enum htsExactFormat format;
   struct {
     short major, minor;
   } version;
@@ -557,5 +753,6 @@ typedef struct {
 
 SEQ_FUNC bool seq_is_htsfile_cram(htsFile *f) { return f->is_cram; }
 SEQ_FUNC bool seq_is_htsfile_bgzf(htsFile *f) { return f->is_bgzf; }
+SEQ_FUNC bool seq_is_htsfile_bcf(htsFile *f) { return f->format.format == bcf; }
 SEQ_FUNC void *seq_get_htsfile_fp(htsFile *f) { return f->fp; }
 SEQ_FUNC double seq_i32_to_float(int32_t x) { return (double)(*(float *)&x); }
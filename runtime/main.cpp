@@ -25,6 +25,11 @@ int main(int argc, char **argv) {
   opt<bool> debug("d", desc("Compile in debug mode"));
   opt<bool> profile("prof", desc("Profile LLVM IR using XRay"));
   opt<bool> docstr("docstr", desc("Generate docstrings"));
+  opt<int> pipelineChunk(
+      "pipeline-chunk",
+      desc("Maximum number of items per parallel pipeline task (overrides "
+           "SEQ_PIPELINE_CHUNK)"),
+      init(0));
   opt<string> output(
       "o",
       desc("Write LLVM bitcode to specified file instead of running with JIT"));
@@ -38,6 +43,12 @@ int main(int argc, char **argv) {
 
   config::config().debug = debug.getValue();
   config::config().profile = profile.getValue();
+  if (pipelineChunk.getValue() < 0) {
+    errs() << "error: invalid pipeline chunk size: "
+           << pipelineChunk.getValue() << "\n";
+    return EXIT_FAILURE;
+  }
+  config::config().pipelineChunk = pipelineChunk.getValue();
 
   if (docstr.getValue()) {
     generateDocstr(argv[0]);
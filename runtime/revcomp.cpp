@@ -0,0 +1,160 @@
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "lib.h"
+
+/*
+ * Reversing and reverse complementing sequence buffers
+ *
+ * Bases are complemented with the same table as `byte.comp()`. To do so in
+ * vector registers, the table is split into 16-entry slices by high nibble,
+ * since byte shuffles (pshufb) only look at the low nibble of each index.
+ * All letters lie in the four slices 0x40-0x7f, so four shuffles, each
+ * masked to the bytes of its slice, complement a block of bases; the rare
+ * blocks containing other bytes (e.g. '-' or '.') are complemented one byte
+ * at a time. Another shuffle reverses the bytes of the block (after which
+ * AVX2 also swaps its two 128-bit lanes). The kernel is picked once, based
+ * on the CPU.
+ */
+
+namespace {
+struct CompTable {
+  uint8_t t[256];
+
+  CompTable() {
+    memset(t, 'N', sizeof(t));
+    const char *from = "ACBDGHKMNSRUTWVYacbdghkmnsrutwvy.-";
+    const char *to = "TGVHCDMKNSYAAWBRtgvhcdmknsyaawbr.-";
+    for (unsigned i = 0; from[i]; i++)
+      t[(uint8_t)from[i]] = (uint8_t)to[i];
+  }
+};
+} // namespace
+
+static const CompTable comp;
+
+typedef void (*reverse_fn_t)(uint8_t *, const uint8_t *, seq_int_t);
+
+// reverses src[0, n) into dst[0, n), one byte at a time
+template <bool Comp>
+static inline void reverse_bytes(uint8_t *dst, const uint8_t *src,
+                                 seq_int_t n) {
+  for (seq_int_t i = 0; i < n; i++)
+    dst[n - i - 1] = Comp ? comp.t[src[i]] : src[i];
+}
+
+template <bool Comp>
+static void reverse_generic(uint8_t *dst, const uint8_t *src, seq_int_t n) {
+  reverse_bytes<Comp>(dst, src, n);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("ssse3"))) static inline bool
+comp16(__m128i v, const __m128i *lut, __m128i *out) {
+  const __m128i low = _mm_set1_epi8(0x0f);
+  const __m128i lo = _mm_and_si128(v, low);
+  const __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low);
+  __m128i r = _mm_setzero_si128();
+  __m128i seen = _mm_setzero_si128();
+  for (int j = 0; j < 4; j++) {
+    const __m128i sel = _mm_cmpeq_epi8(hi, _mm_set1_epi8(4 + j));
+    r = _mm_or_si128(r, _mm_and_si128(sel, _mm_shuffle_epi8(lut[j], lo)));
+    seen = _mm_or_si128(seen, sel);
+  }
+  *out = r;
+  return _mm_movemask_epi8(seen) == 0xffff;
+}
+
+template <bool Comp>
+__attribute__((target("ssse3"))) static void
+reverse_ssse3(uint8_t *dst, const uint8_t *src, seq_int_t n) {
+  const __m128i rev =
+      _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+  __m128i lut[4];
+  for (int j = 0; j < 4; j++)
+    lut[j] = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(comp.t + 16 * (4 + j)));
+
+  seq_int_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    uint8_t *d = dst + (n - i - 16);
+    if (Comp && !comp16(v, lut, &v)) {
+      reverse_bytes<true>(d, src + i, 16);
+      continue;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(d),
+                     _mm_shuffle_epi8(v, rev));
+  }
+  reverse_bytes<Comp>(dst, src + i, n - i);
+}
+
+template <bool Comp>
+__attribute__((target("avx2"))) static void
+reverse_avx2(uint8_t *dst, const uint8_t *src, seq_int_t n) {
+  const __m256i rev = _mm256_setr_epi8(
+      15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11,
+      10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+  const __m256i low = _mm256_set1_epi8(0x0f);
+  __m256i lut[4];
+  for (int j = 0; j < 4; j++)
+    lut[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(comp.t + 16 * (4 + j))));
+
+  seq_int_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    uint8_t *d = dst + (n - i - 32);
+    if (Comp) {
+      const __m256i lo = _mm256_and_si256(v, low);
+      const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+      __m256i r = _mm256_setzero_si256();
+      __m256i seen = _mm256_setzero_si256();
+      for (int j = 0; j < 4; j++) {
+        const __m256i sel = _mm256_cmpeq_epi8(hi, _mm256_set1_epi8(4 + j));
+        r = _mm256_or_si256(
+            r, _mm256_and_si256(sel, _mm256_shuffle_epi8(lut[j], lo)));
+        seen = _mm256_or_si256(seen, sel);
+      }
+      if (_mm256_movemask_epi8(seen) != -1) {
+        reverse_bytes<true>(d, src + i, 32);
+        continue;
+      }
+      v = r;
+    }
+    v = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, rev), 0x4e);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d), v);
+  }
+  reverse_ssse3<Comp>(dst, src + i, n - i);
+}
+#endif
+
+template <bool Comp> static reverse_fn_t reverse_select() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return reverse_avx2<Comp>;
+  if (__builtin_cpu_supports("ssse3"))
+    return reverse_ssse3<Comp>;
+#endif
+  return reverse_generic<Comp>;
+}
+
+static const reverse_fn_t revcomp_impl = reverse_select<true>();
+static const reverse_fn_t reverse_impl = reverse_select<false>();
+
+/*
+ * Writes the reverse complement (or just the reverse) of the n bases at src
+ * to dst. The two buffers must not overlap.
+ */
+SEQ_FUNC void seq_revcomp(uint8_t *dst, const uint8_t *src, seq_int_t n) {
+  revcomp_impl(dst, src, n);
+}
+
+SEQ_FUNC void seq_reverse(uint8_t *dst, const uint8_t *src, seq_int_t n) {
+  reverse_impl(dst, src, n);
+}
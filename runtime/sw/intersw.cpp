@@ -1,83 +1,265 @@
 #include "intersw.h"
+#include "isa.h"
 #include "ksw2.h"
 #include "lib.h"
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
-struct InterAlignParams { // must be consistent with bio/align.seq
-  int8_t a;
-  int8_t b;
-  int8_t ambig;
-  int8_t gapo;
-  int8_t gape;
-  int8_t score_only;
-  int32_t bandwidth;
-  int32_t zdrop;
-  int32_t end_bonus;
-};
+/*
+ * The vector kernels are built for SSE4.1, AVX2 and AVX-512BW, and the
+ * widest one the CPU supports is picked when first used. Setting the
+ * SEQ_INTER_ALIGN_ISA environment variable (or calling
+ * seq_inter_align_set_isa) to an instruction set's name picks a narrower
+ * one instead, e.g. to compare them. Without SSE4.1, pairs are aligned one
+ * at a time with ksw2 (as for pairs too long for the vector kernels).
+ */
+#define SEQ_INTER_ALIGN_ISA_ENV_VAR "SEQ_INTER_ALIGN_ISA"
+
+// for manually invoking OpenMP "parallel", as in lib.cpp
+typedef int32_t kmp_int32;
+typedef struct {
+  kmp_int32 reserved_1;
+  kmp_int32 flags;
+  kmp_int32 reserved_2;
+  kmp_int32 reserved_3;
+  char const *psource;
+} ident_t;
+typedef void (*kmpc_micro)(kmp_int32 *global_tid, kmp_int32 *bound_tid, ...);
+static ident_t dummy_loc = {0, 2, 0, 0, ";unknown;unknown;0;0;;"};
+extern "C" void __kmpc_fork_call(ident_t *, kmp_int32 nargs,
+                                 kmpc_micro microtask, ...);
+extern "C" int omp_get_max_threads();
+
+extern const InterSWKernels intersw_sse41_kernels;
+extern const InterSWKernels intersw_avx2_kernels;
+extern const InterSWKernels intersw_avx512_kernels;
+
+SEQ_FUNC void seq_inter_align1(InterAlignParams *paramsx, SeqPair *seqPairArray,
+                               uint8_t *seqBufRef, uint8_t *seqBufQer,
+                               int numPairs);
+
+static const InterSWKernels intersw_none_kernels = {"none", seq_inter_align1,
+                                                    seq_inter_align1};
 
-SEQ_FUNC void seq_inter_align128(InterAlignParams *paramsx,
+// widest first
+static const InterSWKernels *const intersw_all[] = {
+    &intersw_avx512_kernels, &intersw_avx2_kernels, &intersw_sse41_kernels,
+    &intersw_none_kernels};
+
+static ISADispatch<InterSWKernels, 4>
+    intersw_dispatch(intersw_all, SEQ_INTER_ALIGN_ISA_ENV_VAR);
+
+static const InterSWKernels *intersw_kernels() {
+  return intersw_dispatch.get();
+}
+
+// Name of the instruction set of the kernels in use ("avx512bw", "avx2",
+// "sse4.1" or "none").
+SEQ_FUNC const char *seq_inter_align_isa() { return intersw_kernels()->isa; }
+
+// Name of the i-th instruction set the CPU has kernels for (widest first),
+// or null if there are no more.
+SEQ_FUNC const char *seq_inter_align_isas(seq_int_t i) {
+  return intersw_dispatch.supported(i);
+}
+
+// Switches to the kernels of the given instruction set, returning false
+// (and keeping the current ones) if it is unknown or unsupported.
+SEQ_FUNC bool seq_inter_align_set_isa(const char *isa) {
+  return intersw_dispatch.set(isa);
+}
+
+// Aligns pairs with 8-bit lanes (twice as many as with 16-bit lanes), then
+// aligns the ones whose scores saturated again with 16-bit lanes.
+SEQ_FUNC void seq_inter_align128(InterAlignParams *params,
                                  SeqPair *seqPairArray, uint8_t *seqBufRef,
                                  uint8_t *seqBufQer, int numPairs) {
-  InterAlignParams params = *paramsx;
-  const int8_t bandwidth = (0 <= params.bandwidth && params.bandwidth < 0xff)
-                               ? params.bandwidth
-                               : 0x7f;
-  const int8_t zdrop =
-      (0 <= params.zdrop && params.zdrop < 0xff) ? params.zdrop : 0x7f;
-  if (params.score_only) {
-    SW8 bsw(params.gapo, params.gape, params.gapo, params.gape, zdrop,
-            params.end_bonus, params.a, params.b, params.ambig);
-    bsw.SW(seqPairArray, seqBufRef, seqBufQer, numPairs, bandwidth);
-  } else {
-    SWbt8 bsw(params.gapo, params.gape, params.gapo, params.gape, zdrop,
-              params.end_bonus, params.a, params.b, params.ambig);
-    bsw.SW(seqPairArray, seqBufRef, seqBufQer, numPairs, bandwidth);
+  const InterSWKernels *k = intersw_kernels();
+  k->align8(params, seqPairArray, seqBufRef, seqBufQer, numPairs);
+
+  int n = 0;
+  for (int i = 0; i < numPairs; i++) {
+    if (seqPairArray[i].flags & INTERSW_SATURATED)
+      n++;
+  }
+  if (n == 0)
+    return;
+
+  // pair IDs locate the sequences in the buffers, so can be kept as is;
+  // redo lives on the GC heap since it holds the only pointers to the
+  // CIGARs align16 allocates until they are copied back
+  SeqPair *redo = (SeqPair *)seq_alloc(n * sizeof(SeqPair));
+  int *idx = (int *)malloc(n * sizeof(int));
+  if (!redo || !idx) {
+    fprintf(stderr, "failed to allocate memory for inter-sequence alignment\n");
+    exit(EXIT_FAILURE);
   }
+  for (int i = 0, j = 0; i < numPairs; i++) {
+    SeqPair *sp = &seqPairArray[i];
+    if (sp->flags & INTERSW_SATURATED) {
+      sp->flags &= ~INTERSW_SATURATED;
+      redo[j] = *sp;
+      idx[j++] = i;
+    }
+  }
+  k->align16(params, redo, seqBufRef, seqBufQer, n);
+  for (int j = 0; j < n; j++)
+    seqPairArray[idx[j]] = redo[j];
+  seq_free(redo);
+  free(idx);
 }
 
-SEQ_FUNC void seq_inter_align16(InterAlignParams *paramsx,
+SEQ_FUNC void seq_inter_align16(InterAlignParams *params,
                                 SeqPair *seqPairArray, uint8_t *seqBufRef,
                                 uint8_t *seqBufQer, int numPairs) {
-  InterAlignParams params = *paramsx;
-  const int16_t bandwidth = (0 <= params.bandwidth && params.bandwidth < 0xffff)
-                                ? params.bandwidth
-                                : 0x7fff;
-  const int16_t zdrop =
-      (0 <= params.zdrop && params.zdrop < 0xffff) ? params.zdrop : 0x7fff;
-  if (params.score_only) {
-    SW16 bsw(params.gapo, params.gape, params.gapo, params.gape, zdrop,
-             params.end_bonus, params.a, params.b, params.ambig);
-    bsw.SW(seqPairArray, seqBufRef, seqBufQer, numPairs, bandwidth);
-  } else {
-    SWbt16 bsw(params.gapo, params.gape, params.gapo, params.gape, zdrop,
-               params.end_bonus, params.a, params.b, params.ambig);
-    bsw.SW(seqPairArray, seqBufRef, seqBufQer, numPairs, bandwidth);
-  }
+  intersw_kernels()->align16(params, seqPairArray, seqBufRef, seqBufQer,
+                             numPairs);
+}
+
+static void intersw_mat(const InterAlignParams &params, int8_t *mat) {
+  const int8_t a = params.a > 0 ? params.a : -params.a;
+  const int8_t b = params.b > 0 ? -params.b : params.b;
+  const int8_t ambig = params.ambig > 0 ? -params.ambig : params.ambig;
+  const int8_t m[] = {a,     b,     b,     b,     ambig, b,     a,    b, b,
+                      ambig, b,     b,     a,     b,     ambig, b,    b, b,
+                      a,     ambig, ambig, ambig, ambig, ambig, ambig};
+  memcpy(mat, m, sizeof(m));
+}
+
+static void intersw_align1(const InterAlignParams &params, const int8_t *mat,
+                           SeqPair *sp, const uint8_t *ref,
+                           const uint8_t *qer) {
+  ksw_extz_t ez;
+  int flags = (params.score_only ? KSW_EZ_SCORE_ONLY : 0) | sp->flags;
+  ksw_reset_extz(&ez);
+  ksw_extz2_sse(nullptr, sp->len2, qer, sp->len1, ref, /*m=*/5, mat,
+                params.gapo, params.gape, params.bandwidth, params.zdrop,
+                params.end_bonus, flags, &ez);
+  sp->score = (flags & KSW_EZ_EXTZ_ONLY) ? ez.max : ez.score;
+  sp->cigar = ez.cigar;
+  sp->n_cigar = ez.n_cigar;
 }
 
 SEQ_FUNC void seq_inter_align1(InterAlignParams *paramsx, SeqPair *seqPairArray,
                                uint8_t *seqBufRef, uint8_t *seqBufQer,
                                int numPairs) {
   InterAlignParams params = *paramsx;
-  int8_t a = params.a > 0 ? params.a : -params.a;
-  int8_t b = params.b > 0 ? -params.b : params.b;
-  int8_t ambig = params.ambig > 0 ? -params.ambig : params.ambig;
-  int8_t mat[] = {a,     b,     b,     b,     ambig, b,     a,    b, b,
-                  ambig, b,     b,     a,     b,     ambig, b,    b, b,
-                  a,     ambig, ambig, ambig, ambig, ambig, ambig};
-  ksw_extz_t ez;
-  int flags = params.score_only ? KSW_EZ_SCORE_ONLY : 0;
+  int8_t mat[25];
+  intersw_mat(params, mat);
   for (int i = 0; i < numPairs; i++) {
     SeqPair *sp = &seqPairArray[i];
-    int myflags = flags | sp->flags;
-    ksw_reset_extz(&ez);
-    ksw_extz2_sse(nullptr, sp->len2, seqBufQer + SW8::LEN_LIMIT * sp->id,
-                  sp->len1, seqBufRef + SW8::LEN_LIMIT * sp->id, /*m=*/5, mat,
-                  params.gapo, params.gape, params.bandwidth, params.zdrop,
-                  params.end_bonus, myflags, &ez);
-    sp->score = (myflags & KSW_EZ_EXTZ_ONLY) ? ez.max : ez.score;
-    sp->cigar = ez.cigar;
-    sp->n_cigar = ez.n_cigar;
+    intersw_align1(params, mat, sp, seqBufRef + INTERSW_LEN_LIMIT * sp->id,
+                   seqBufQer + INTERSW_LEN_LIMIT * sp->id);
+  }
+}
+
+namespace {
+struct InterAlignBatch {
+  InterAlignParams params;
+  int8_t mat[25];
+  // pairs for the vector kernels
+  SeqPair *pairs;
+  uint8_t *bufRef;
+  uint8_t *bufQer;
+  int num128;
+  int num16;
+  // long pairs, longest first
+  SeqPair *longPairs;
+  const uint8_t *const *longRefs;
+  const int *order;
+  int numLong;
+  std::atomic<bool> claimed;
+  std::atomic<int> next;
+};
+} // namespace
+
+static void intersw_align_long(InterAlignBatch *batch) {
+  int i;
+  while ((i = batch->next.fetch_add(1, std::memory_order_relaxed)) <
+         batch->numLong) {
+    const int k = batch->order[i];
+    SeqPair *sp = &batch->longPairs[k];
+    const uint8_t *ref = batch->longRefs[k];
+    intersw_align1(batch->params, batch->mat, sp, ref, ref + sp->len1);
+  }
+}
+
+static void intersw_align_batch(kmp_int32 *global_tid, kmp_int32 *bound_tid,
+                                InterAlignBatch *batch) {
+  // whichever thread gets here first runs the vector kernels
+  if (!batch->claimed.exchange(true, std::memory_order_relaxed)) {
+    if (batch->num128 > 0)
+      seq_inter_align128(&batch->params, batch->pairs, batch->bufRef,
+                         batch->bufQer, batch->num128);
+    if (batch->num16 > 0)
+      seq_inter_align16(&batch->params, batch->pairs + batch->num128,
+                        batch->bufRef, batch->bufQer, batch->num16);
+  }
+  intersw_align_long(batch);
+}
+
+// Aligns a batch of pairs sorted by length: the first num128 and the next
+// num16 pairs go to the 8- and 16-bit vector kernels, while the numLong
+// pairs after them are too long for the kernels' buffers and have their
+// reference and query stored back to back in longBuf instead. Long pairs
+// are aligned one at a time with ksw2, spread over the OpenMP threads: one
+// thread runs the vector kernels while the others start on the long pairs,
+// then joins them.
+SEQ_FUNC void seq_inter_align_batch(InterAlignParams *params,
+                                    SeqPair *seqPairArray, uint8_t *seqBufRef,
+                                    uint8_t *seqBufQer, int num128, int num16,
+                                    uint8_t *longBuf, int numLong) {
+  InterAlignBatch batch;
+  batch.params = *params;
+  intersw_mat(batch.params, batch.mat);
+  batch.pairs = seqPairArray;
+  batch.bufRef = seqBufRef;
+  batch.bufQer = seqBufQer;
+  batch.num128 = num128;
+  batch.num16 = num16;
+  batch.longPairs = seqPairArray + num128 + num16;
+  batch.numLong = numLong;
+  batch.claimed.store(false, std::memory_order_relaxed);
+  batch.next.store(0, std::memory_order_relaxed);
+  if (numLong == 0) {
+    batch.longRefs = nullptr;
+    batch.order = nullptr;
+    intersw_align_batch(nullptr, nullptr, &batch);
+    return;
+  }
+
+  const uint8_t **refs = (const uint8_t **)malloc(numLong * sizeof(uint8_t *));
+  int *order = (int *)malloc(numLong * sizeof(int));
+  if (!refs || !order) {
+    fprintf(stderr, "failed to allocate memory for inter-sequence alignment\n");
+    exit(EXIT_FAILURE);
+  }
+  const uint8_t *p = longBuf;
+  for (int i = 0; i < numLong; i++) {
+    const SeqPair &sp = batch.longPairs[i];
+    refs[i] = p;
+    p += sp.len1 + sp.len2;
+    order[i] = i;
+  }
+  // largest DP matrices first, so that no thread is left with a big one at
+  // the end
+  std::sort(order, order + numLong, [&](int x, int y) {
+    const SeqPair &a = batch.longPairs[x], &b = batch.longPairs[y];
+    return (int64_t)a.len1 * a.len2 > (int64_t)b.len1 * b.len2;
+  });
+  batch.longRefs = refs;
+  batch.order = order;
+
+  if (omp_get_max_threads() > 1) {
+    // equivalent to: #pragma omp parallel { intersw_align_batch }
+    __kmpc_fork_call(&dummy_loc, 1, (kmpc_micro)intersw_align_batch, &batch);
+  } else {
+    intersw_align_batch(nullptr, nullptr, &batch);
   }
+  free(refs);
+  free(order);
 }
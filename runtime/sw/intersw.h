@@ -1,5 +1,10 @@
 // Inter-sequence alignment kernel adapted from BWA-MEM2
 // https://github.com/bwa-mem2/bwa-mem2/blob/master/src/bandedSWA.cpp
+//
+// The kernels are compiled once per instruction set, each time by a source
+// file that defines INTERSW_ISA (the namespace to put that build in) and
+// is compiled with the matching target flags; intersw.cpp picks one at
+// runtime. Code shared by all builds goes above the namespace.
 #pragma once
 
 #include "ksw2.h"
@@ -9,18 +14,12 @@
 #include <cstdlib>
 #include <cstring>
 #include <immintrin.h>
+#include <limits>
 
 extern "C" void *seq_alloc_atomic(size_t n);
 extern "C" void *seq_realloc(void *p, size_t n);
 extern "C" void seq_free(void *p);
 
-void pv(const char *tag, __m256i var) {
-  int16_t *val = (int16_t *)&var;
-  printf("%s: %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d\n", tag, val[0],
-         val[1], val[2], val[3], val[4], val[5], val[6], val[7], val[8], val[9],
-         val[10], val[11], val[12], val[13], val[14], val[15]);
-}
-
 struct SeqPair {
   int32_t id;
   int32_t len1, len2;
@@ -30,11 +29,46 @@ struct SeqPair {
   int32_t flags;
 };
 
+struct InterAlignParams { // must be consistent with bio/align.seq
+  int8_t a;
+  int8_t b;
+  int8_t ambig;
+  int8_t gapo;
+  int8_t gape;
+  int8_t score_only;
+  int32_t bandwidth;
+  int32_t zdrop;
+  int32_t end_bonus;
+};
+
+// maximum length of either sequence of a pair; each is stored at a stride
+// of this many bytes in the sequence buffers
+static constexpr size_t INTERSW_LEN_LIMIT = 512;
+
+// Set in SeqPair::flags by the 8-bit kernels on pairs whose score may have
+// saturated; these pairs have no score or CIGAR and must be aligned again
+// with 16-bit lanes.
+#define INTERSW_SATURATED 0x40000000
+
+typedef void (*inter_align_fn_t)(InterAlignParams *, SeqPair *, uint8_t *,
+                                 uint8_t *, int);
+
+// kernels built for one instruction set
+struct InterSWKernels {
+  const char *isa;
+  inter_align_fn_t align8;
+  inter_align_fn_t align16;
+};
+
+#ifdef INTERSW_ISA
+namespace INTERSW_ISA {
+
 #define min_(x, y) ((x) > (y) ? (y) : (x))
 #define max_(x, y) ((x) > (y) ? (x) : (y))
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-variable"
+#pragma GCC diagnostic ignored "-Wpsabi"
 
 #if defined(__clang__) || defined(__GNUC__)
 #define __mmask8 uint8_t
@@ -84,6 +118,10 @@ template <> struct SIMD<128, 8> {
 
   static inline Vec sub(Vec a, Vec b) { return _mm_sub_epi8(a, b); }
 
+  static inline Vec adds(Vec a, Vec b) { return _mm_adds_epi8(a, b); }
+
+  static inline Vec subs(Vec a, Vec b) { return _mm_subs_epi8(a, b); }
+
   static inline Vec min(Vec a, Vec b) { return _mm_min_epi8(a, b); }
 
   static inline Vec max(Vec a, Vec b) { return _mm_max_epi8(a, b); }
@@ -146,6 +184,10 @@ template <> struct SIMD<256, 8> {
 
   static inline Vec sub(Vec a, Vec b) { return _mm256_sub_epi8(a, b); }
 
+  static inline Vec adds(Vec a, Vec b) { return _mm256_adds_epi8(a, b); }
+
+  static inline Vec subs(Vec a, Vec b) { return _mm256_subs_epi8(a, b); }
+
   static inline Vec min(Vec a, Vec b) { return _mm256_min_epi8(a, b); }
 
   static inline Vec max(Vec a, Vec b) { return _mm256_max_epi8(a, b); }
@@ -210,6 +252,10 @@ template <> struct SIMD<512, 8> {
 
   static inline Vec sub(Vec a, Vec b) { return _mm512_sub_epi8(a, b); }
 
+  static inline Vec adds(Vec a, Vec b) { return _mm512_adds_epi8(a, b); }
+
+  static inline Vec subs(Vec a, Vec b) { return _mm512_subs_epi8(a, b); }
+
   static inline Vec min(Vec a, Vec b) { return _mm512_min_epi8(a, b); }
 
   static inline Vec max(Vec a, Vec b) { return _mm512_max_epi8(a, b); }
@@ -270,6 +316,10 @@ template <> struct SIMD<128, 16> {
 
   static inline Vec sub(Vec a, Vec b) { return _mm_sub_epi16(a, b); }
 
+  static inline Vec adds(Vec a, Vec b) { return _mm_adds_epi16(a, b); }
+
+  static inline Vec subs(Vec a, Vec b) { return _mm_subs_epi16(a, b); }
+
   static inline Vec min(Vec a, Vec b) { return _mm_min_epi16(a, b); }
 
   static inline Vec max(Vec a, Vec b) { return _mm_max_epi16(a, b); }
@@ -332,6 +382,10 @@ template <> struct SIMD<256, 16> {
 
   static inline Vec sub(Vec a, Vec b) { return _mm256_sub_epi16(a, b); }
 
+  static inline Vec adds(Vec a, Vec b) { return _mm256_adds_epi16(a, b); }
+
+  static inline Vec subs(Vec a, Vec b) { return _mm256_subs_epi16(a, b); }
+
   static inline Vec min(Vec a, Vec b) { return _mm256_min_epi16(a, b); }
 
   static inline Vec max(Vec a, Vec b) { return _mm256_max_epi16(a, b); }
@@ -396,6 +450,10 @@ template <> struct SIMD<512, 16> {
 
   static inline Vec sub(Vec a, Vec b) { return _mm512_sub_epi16(a, b); }
 
+  static inline Vec adds(Vec a, Vec b) { return _mm512_adds_epi16(a, b); }
+
+  static inline Vec subs(Vec a, Vec b) { return _mm512_subs_epi16(a, b); }
+
   static inline Vec min(Vec a, Vec b) { return _mm512_min_epi16(a, b); }
 
   static inline Vec max(Vec a, Vec b) { return _mm512_max_epi16(a, b); }
@@ -429,7 +487,7 @@ template <> struct SIMD<512, 16> {
 
 template <unsigned W, unsigned N, bool CIGAR = false> class InterSW {
 public:
-  static constexpr size_t LEN_LIMIT = 512;
+  static constexpr size_t LEN_LIMIT = INTERSW_LEN_LIMIT;
   using int_t = typename SIMD<W, N>::int_t;
   using uint_t = typename SIMD<W, N>::uint_t;
 
@@ -565,14 +623,13 @@ void InterSW<W, N, CIGAR>::SW(SeqPair *pairArray, uint8_t *seqBufRef,
     bool ext[SIMD_WIDTH];
     uint_t bsize = 0;
 
+    int qmax[SIMD_WIDTH];
     Vec zero128 = S::zero();
     Vec o_ins128 = S::set(o_ins);
     Vec e_ins128 = S::set(e_ins);
     Vec oe_ins128 = S::set(o_ins + e_ins);
     Vec o_del128 = S::set(o_del);
     Vec e_del128 = S::set(e_del);
-    Vec eb_ins128 = S::set(eb - o_ins);
-    Vec eb_del128 = S::set(eb - o_del);
 
     int_t max = 0;
     if (max < w_match)
@@ -606,7 +663,7 @@ void InterSW<W, N, CIGAR>::SW(SeqPair *pairArray, uint8_t *seqBufRef,
           mySeq1SoA[k * SIMD_WIDTH + j] = (seq1[k] == AMBIG ? FF : seq1[k]);
           H2[k * SIMD_WIDTH + j] = 0;
         }
-        qlen[j] = sp.len2 * max;
+        qmax[j] = sp.len2 * max;
         if (maxLen1 < sp.len1)
           maxLen1 = sp.len1;
       }
@@ -621,10 +678,10 @@ void InterSW<W, N, CIGAR>::SW(SeqPair *pairArray, uint8_t *seqBufRef,
 
       Vec h0_128 = S::load((Vec *)h0);
       S::store((Vec *)H2, h0_128);
-      Vec tmp128 = S::sub(h0_128, o_del128);
+      Vec tmp128 = S::subs(h0_128, o_del128);
 
       for (k = 1; k < maxLen1; k++) {
-        tmp128 = S::sub(tmp128, e_del128);
+        tmp128 = S::subs(tmp128, e_del128);
         S::store((Vec *)(H2 + k * SIMD_WIDTH), tmp128);
       }
 
@@ -654,36 +711,26 @@ void InterSW<W, N, CIGAR>::SW(SeqPair *pairArray, uint8_t *seqBufRef,
 
       S::store((Vec *)H1, h0_128);
       Cmp cmp128;
-      tmp128 = S::sub(h0_128, oe_ins128);
+      tmp128 = S::subs(h0_128, oe_ins128);
       S::store((Vec *)(H1 + SIMD_WIDTH), tmp128);
       for (k = 2; k < maxLen2; k++) {
         Vec h1_128 = tmp128;
-        tmp128 = S::sub(h1_128, e_ins128);
+        tmp128 = S::subs(h1_128, e_ins128);
         S::store((Vec *)(H1 + k * SIMD_WIDTH), tmp128);
       }
 
+      // band as in ksw_extz2; computed in ints since qlen * max need not
+      // fit in uint_t
       uint_t myband[SIMD_WIDTH] __attribute__((aligned(64)));
-      uint_t temp[SIMD_WIDTH] __attribute__((aligned(64)));
-      {
-        Vec qlen128 = S::load((Vec *)qlen);
-        Vec sum128 = S::add(qlen128, eb_ins128);
-        S::store((Vec *)temp, sum128);
-        for (int l = 0; l < SIMD_WIDTH; l++) {
-          double val = temp[l] / e_ins + 1.0;
-          int max_ins = (int)val;
-          max_ins = max_ins > 1 ? max_ins : 1;
-          myband[l] = min_(bsize, max_ins);
-        }
-        sum128 = S::add(qlen128, eb_del128);
-        S::store((Vec *)temp, sum128);
-        for (int l = 0; l < SIMD_WIDTH; l++) {
-          double val = temp[l] / e_del + 1.0;
-          int max_ins = (int)val;
-          max_ins = max_ins > 1 ? max_ins : 1;
-          myband[l] = min_(myband[l], max_ins);
-          myband[l] = ext[l] ? myband[l] : w;
-          bsize = bsize < myband[l] ? myband[l] : bsize;
-        }
+      for (int l = 0; l < SIMD_WIDTH; l++) {
+        int max_ins = (int)((double)(qmax[l] + eb - o_ins) / e_ins + 1.0);
+        max_ins = max_ins > 1 ? max_ins : 1;
+        myband[l] = min_(bsize, max_ins);
+        int max_del = (int)((double)(qmax[l] + eb - o_del) / e_del + 1.0);
+        max_del = max_del > 1 ? max_del : 1;
+        myband[l] = min_(myband[l], max_del);
+        myband[l] = ext[l] ? myband[l] : w;
+        bsize = bsize < myband[l] ? myband[l] : bsize;
       }
 
       if (CIGAR)
@@ -715,7 +762,18 @@ void InterSW<W, N, CIGAR>::SWCore(uint_t seq1SoA[], uint_t seq2SoA[],
   constexpr int MAX_SEQ_LEN = S::MAX_SEQ_LEN;
   constexpr int SIMD_WIDTH = W / N;
   constexpr uint_t FF = (1 << N) - 1;
-  constexpr int_t NEG_INF = -(1 << (N - 2));
+  // scores saturate, so 8-bit lanes can use their whole range
+  constexpr int_t INT_MIN_ = std::numeric_limits<int_t>::min();
+  constexpr int_t INT_MAX_ = std::numeric_limits<int_t>::max();
+  constexpr int_t NEG_INF = N == 8 ? INT_MIN_ : -(1 << (N - 2));
+
+  int_t max = 0;
+  if (max < w_match)
+    max = w_match;
+  if (max < w_mismatch)
+    max = w_mismatch;
+  if (max < w_ambig)
+    max = w_ambig;
 
   Vec match256 = S::set(this->w_match);
   Vec mismatch256 = S::set(this->w_mismatch);
@@ -737,6 +795,8 @@ void InterSW<W, N, CIGAR>::SWCore(uint_t seq1SoA[], uint_t seq2SoA[],
   uint_t tlen[SIMD_WIDTH];
   uint_t tail[SIMD_WIDTH] __attribute((aligned(64)));
   uint_t head[SIMD_WIDTH] __attribute((aligned(64)));
+  int_t bound[SIMD_WIDTH] __attribute((aligned(64)));
+  int_t ext[SIMD_WIDTH] __attribute((aligned(64)));
 
   int minq = 10000000;
   for (int l = 0; l < SIMD_WIDTH; l++) {
@@ -744,6 +804,8 @@ void InterSW<W, N, CIGAR>::SWCore(uint_t seq1SoA[], uint_t seq2SoA[],
     qlen[l] = p[l].len2;
     if (p[l].len2 < minq)
       minq = p[l].len2;
+    bound[l] = min_(NEG_INF + max * min_(p[l].len1, p[l].len2), INT_MAX_);
+    ext[l] = (p[l].flags & KSW_EZ_EXTZ_ONLY) ? -1 : 0;
   }
   minq -= 1; // for gscore
 
@@ -779,7 +841,22 @@ void InterSW<W, N, CIGAR>::SWCore(uint_t seq1SoA[], uint_t seq2SoA[],
   Vec gscore = S::set(-1);
   Vec max_off256 = zero256;
   Vec exit0 = S::set(FF);
-  Vec zdrop256 = S::set(zdrop);
+  // a negative zdrop (only passed for 8-bit lanes) disables Z-drop
+  Vec zdrop256 = S::set(zdrop < 0 || zdrop > INT_MAX_ ? INT_MAX_ : zdrop);
+
+  // With 8-bit lanes, a cell next to a saturated or NEG_INF cell can get a
+  // wrong score, but only up to floor256 (one match above NEG_INF). If all
+  // cells of a pair that are kept or counted score higher, all of them are
+  // exact. Otherwise (low256), wrong scores still stay below bound256, as
+  // they can gain at most one match per row and column.
+  Vec floor256 = S::set(NEG_INF + max);
+  Vec bound256 = S::load((Vec *)bound);
+  Vec intmax256 = S::set(INT_MAX_);
+  Vec low256 = zero256;
+  // pairs that Z-drop might have stopped, if low256 or not
+  Vec zbound256 = zero256;
+  Vec zfloor256 = zero256;
+  Cmp ext256 = S::vec2cmp(S::load((Vec *)ext));
 
   int beg = 0, end = ncol;
   int nbeg = beg, nend = end;
@@ -805,6 +882,7 @@ void InterSW<W, N, CIGAR>::SWCore(uint_t seq1SoA[], uint_t seq2SoA[],
 
     Vec j256 = zero256;
     Vec maxRS1 = init256;
+    Vec minRS1 = intmax256;
 
     Vec i1_256 = S::set(i + 1);
     Vec y1_256 = zero256;
@@ -877,7 +955,7 @@ void InterSW<W, N, CIGAR>::SWCore(uint_t seq1SoA[], uint_t seq2SoA[],
       Vec tmp256 = S::umax(s10, s2);
       cmp11 = S::vec2cmp(tmp256);
       sbt11 = S::blend(sbt11, w_ambig_256, cmp11);
-      Vec m11 = S::add(h00, sbt11);
+      Vec m11 = S::adds(h00, sbt11);
       if (CIGAR) {
         dcmp = S::orc_(S::gt(m11, e11), S::eq(m11, e11));
         d = S::blend(two256, zero256, dcmp);
@@ -888,18 +966,18 @@ void InterSW<W, N, CIGAR>::SWCore(uint_t seq1SoA[], uint_t seq2SoA[],
         d = S::blend(one256, d, dcmp);
       }
       h11 = S::max(h11, f11);
-      Vec temp256 = S::sub(m11, oe_ins256);
+      Vec temp256 = S::subs(m11, oe_ins256);
       Vec val256 = temp256;
-      e11 = S::sub(e11, e_ins256);
+      e11 = S::subs(e11, e_ins256);
       if (CIGAR) {
         dcmp = S::gt(e11, val256);
         dtmp = S::blend(zero256, S::set(0x10), dcmp);
         d = S::or_(d, dtmp);
       }
       e11 = S::max(val256, e11);
-      temp256 = S::sub(m11, oe_del256);
+      temp256 = S::subs(m11, oe_del256);
       val256 = temp256;
-      f21 = S::sub(f11, e_del256);
+      f21 = S::subs(f11, e_del256);
       if (CIGAR) {
         dcmp = S::gt(f21, val256);
         dtmp = S::blend(zero256, S::set(0x08), dcmp);
@@ -928,6 +1006,11 @@ void InterSW<W, N, CIGAR>::SWCore(uint_t seq1SoA[], uint_t seq2SoA[],
       blend256 = S::blend(y1_256, j256, cmpA);
       y1_256 = S::blend(blend256, y1_256, cmp1);
       maxRS1 = S::blend(maxRS1, bmaxRS, cmp1);
+      if (N == 8) {
+        // h11 is kept (in H_h[j + 1]) unless out of [head, tail]
+        cmp1 = S::orc_(S::gt(j256, tail256), S::gt(head256, j256));
+        minRS1 = S::min(minRS1, S::blend(h11, intmax256, cmp1));
+      }
 
       S::store((Vec *)(F + j * SIMD_WIDTH), f21);
       S::store((Vec *)(H_h + j * SIMD_WIDTH), h10);
@@ -1001,15 +1084,32 @@ void InterSW<W, N, CIGAR>::SWCore(uint_t seq1SoA[], uint_t seq2SoA[],
     Vec tmpi = S::sub(i1_256, x256);
     Vec tmpj = S::sub(y1_256, y256);
     cmp = S::gt(tmpi, tmpj);
-    score256 = S::sub(maxScore256, maxRS1);
+    score256 = S::subs(maxScore256, maxRS1);
     Vec insdel = S::blend(e_ins256, e_del256, cmp);
-    Vec sub_a256 = S::sub(tmpi, tmpj);
-    Vec sub_b256 = S::sub(tmpj, tmpi);
+    Vec sub_a256 = S::subs(tmpi, tmpj);
+    Vec sub_b256 = S::subs(tmpj, tmpi);
     Vec tmp = S::blend(sub_b256, sub_a256, cmp);
-    tmp = S::sub(score256, tmp);
+    tmp = S::subs(score256, tmp);
     cmp = S::gt(tmp, zdrop256);
     exit0 = S::blend(exit0, zero256, cmp);
     gscore = S::blend(gscore, neg_inf256, cmp);
+    if (N == 8) {
+      // rows past the end of a sequence only hold dummy bases
+      minRS1 = S::blend(minRS1, intmax256, cmp256_1);
+      Cmp low = S::xorc_(S::gt(minRS1, floor256), S::ff());
+      low256 = S::blend(low256, ff256, low);
+    }
+    if (N == 8 && zdrop >= 0) {
+      // the drop is decided wrongly only if the row maximum (or where it
+      // is) is wrong, or if no drop is found as the difference saturated;
+      // past the end of the sequences, this only matters for gscore
+      Cmp sat = S::andc_(S::eq(score256, intmax256), S::xorc_(cmp, S::ff()));
+      Cmp keep = S::xorc_(S::andc_(cmp256_1, ext256), S::ff());
+      Cmp unsure = S::orc_(S::xorc_(S::gt(maxRS1, floor256), S::ff()), sat);
+      zfloor256 = S::blend(zfloor256, ff256, S::andc_(unsure, keep));
+      unsure = S::orc_(S::xorc_(S::gt(maxRS1, bound256), S::ff()), sat);
+      zbound256 = S::blend(zbound256, ff256, S::andc_(unsure, keep));
+    }
 
     /* Narrowing of the band */
     /* From beg */
@@ -1078,7 +1178,7 @@ void InterSW<W, N, CIGAR>::SWCore(uint_t seq1SoA[], uint_t seq2SoA[],
       tmpb = tmp;
     }
     index256 = S::add(index256, two256);
-    tail256 = S::min(index256, qlen256);
+    tail256 = S::umin(index256, qlen256);
   }
 
   int_t score[SIMD_WIDTH] __attribute((aligned(64)));
@@ -1096,6 +1196,13 @@ void InterSW<W, N, CIGAR>::SWCore(uint_t seq1SoA[], uint_t seq2SoA[],
   int_t gscore_ar[SIMD_WIDTH] __attribute((aligned(64)));
   S::store((Vec *)gscore_ar, gscore);
 
+  int_t low[SIMD_WIDTH] __attribute((aligned(64)));
+  int_t zbound[SIMD_WIDTH] __attribute((aligned(64)));
+  int_t zfloor[SIMD_WIDTH] __attribute((aligned(64)));
+  S::store((Vec *)low, low256);
+  S::store((Vec *)zbound, zbound256);
+  S::store((Vec *)zfloor, zfloor256);
+
   // int_t maxie_ar[SIMD_WIDTH] __attribute((aligned(64)));
   // S::store((Vec *)maxie_ar, max_ie256);
 
@@ -1104,6 +1211,14 @@ void InterSW<W, N, CIGAR>::SWCore(uint_t seq1SoA[], uint_t seq2SoA[],
       break;
     const bool ext_only = (p[i].flags & KSW_EZ_EXTZ_ONLY) != 0;
     p[i].score = ext_only ? score[i] : gscore_ar[i];
+    if (N == 8 &&
+        (score[i] >= INT_MAX_ - max ||
+         (low[i] ? zbound[i] || p[i].score <= bound[i] : zfloor[i]))) {
+      p[i].flags |= INTERSW_SATURATED;
+      p[i].cigar = nullptr;
+      p[i].n_cigar = 0;
+      continue;
+    }
     if (p[i].score == NEG_INF)
       p[i].score = KSW_NEG_INF;
 
@@ -1208,24 +1323,51 @@ void InterSW<W, N, CIGAR>::SWBacktrace(bool is_rot, bool is_rev,
   *m_cigar_ = m_cigar, *n_cigar_ = n_cigar, *cigar_ = cigar;
 }
 
-#if ((!__AVX512BW__) & (__AVX2__))
-typedef InterSW<256, 8, /*CIGAR=*/false> SW8;
-typedef InterSW<256, 8, /*CIGAR=*/true> SWbt8;
-typedef InterSW<256, 16, /*CIGAR=*/false> SW16;
-typedef InterSW<256, 16, /*CIGAR=*/true> SWbt16;
-#endif
-#if __AVX512BW__
-typedef InterSW<512, 8, /*CIGAR=*/false> SW8;
-typedef InterSW<512, 8, /*CIGAR=*/true> SWbt8;
-typedef InterSW<512, 16, /*CIGAR=*/false> SW16;
-typedef InterSW<512, 16, /*CIGAR=*/true> SWbt16;
-#endif
-#if ((!__AVX512BW__) & (!__AVX2__) & (__SSE2__))
-typedef InterSW<128, 8, /*CIGAR=*/false> SW8;
-typedef InterSW<128, 8, /*CIGAR=*/true> SWbt8;
-typedef InterSW<128, 16, /*CIGAR=*/false> SW16;
-typedef InterSW<128, 16, /*CIGAR=*/true> SWbt16;
-#endif
-#if ((!__AVX512BW__) & (!__AVX2__) & (!__SSE2__))
-#error "no SSE support on this architecture"
-#endif
+template <unsigned W>
+void align8(InterAlignParams *paramsx, SeqPair *seqPairArray,
+            uint8_t *seqBufRef, uint8_t *seqBufQer, int numPairs) {
+  InterAlignParams params = *paramsx;
+  // sequences are at most 0x7f long, so a wider band covers them already;
+  // unlike with 16-bit lanes, a Z-drop as large as 0x7f is not the same as
+  // none, which is therefore passed on as -1
+  const int8_t bandwidth = (0 <= params.bandwidth && params.bandwidth < 0x7f)
+                               ? params.bandwidth
+                               : 0x7f;
+  const int zdrop = params.zdrop >= 0 ? params.zdrop : -1;
+  if (params.score_only) {
+    InterSW<W, 8, /*CIGAR=*/false> bsw(
+        params.gapo, params.gape, params.gapo, params.gape, zdrop,
+        params.end_bonus, params.a, params.b, params.ambig);
+    bsw.SW(seqPairArray, seqBufRef, seqBufQer, numPairs, bandwidth);
+  } else {
+    InterSW<W, 8, /*CIGAR=*/true> bsw(
+        params.gapo, params.gape, params.gapo, params.gape, zdrop,
+        params.end_bonus, params.a, params.b, params.ambig);
+    bsw.SW(seqPairArray, seqBufRef, seqBufQer, numPairs, bandwidth);
+  }
+}
+
+template <unsigned W>
+void align16(InterAlignParams *paramsx, SeqPair *seqPairArray,
+             uint8_t *seqBufRef, uint8_t *seqBufQer, int numPairs) {
+  InterAlignParams params = *paramsx;
+  const int16_t bandwidth = (0 <= params.bandwidth && params.bandwidth < 0xffff)
+                                ? params.bandwidth
+                                : 0x7fff;
+  const int16_t zdrop =
+      (0 <= params.zdrop && params.zdrop < 0xffff) ? params.zdrop : 0x7fff;
+  if (params.score_only) {
+    InterSW<W, 16, /*CIGAR=*/false> bsw(
+        params.gapo, params.gape, params.gapo, params.gape, zdrop,
+        params.end_bonus, params.a, params.b, params.ambig);
+    bsw.SW(seqPairArray, seqBufRef, seqBufQer, numPairs, bandwidth);
+  } else {
+    InterSW<W, 16, /*CIGAR=*/true> bsw(
+        params.gapo, params.gape, params.gapo, params.gape, zdrop,
+        params.end_bonus, params.a, params.b, params.ambig);
+    bsw.SW(seqPairArray, seqBufRef, seqBufQer, numPairs, bandwidth);
+  }
+}
+
+} // namespace INTERSW_ISA
+#endif // INTERSW_ISA
@@ -0,0 +1,6 @@
+// AVX2 build of the inter-sequence alignment kernels (see intersw.h)
+#define INTERSW_ISA intersw_avx2
+#include "intersw.h"
+
+extern const InterSWKernels intersw_avx2_kernels = {
+    "avx2", intersw_avx2::align8<256>, intersw_avx2::align16<256>};
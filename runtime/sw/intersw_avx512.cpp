@@ -0,0 +1,6 @@
+// AVX-512BW build of the inter-sequence alignment kernels (see intersw.h)
+#define INTERSW_ISA intersw_avx512
+#include "intersw.h"
+
+extern const InterSWKernels intersw_avx512_kernels = {
+    "avx512bw", intersw_avx512::align8<512>, intersw_avx512::align16<512>};
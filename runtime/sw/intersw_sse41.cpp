@@ -0,0 +1,6 @@
+// SSE4.1 build of the inter-sequence alignment kernels (see intersw.h)
+#define INTERSW_ISA intersw_sse41
+#include "intersw.h"
+
+extern const InterSWKernels intersw_sse41_kernels = {
+    "sse4.1", intersw_sse41::align8<128>, intersw_sse41::align16<128>};
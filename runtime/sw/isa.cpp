@@ -0,0 +1,13 @@
+#include "isa.h"
+
+bool isa_supported(const char *isa) {
+  __builtin_cpu_init();
+  if (strcmp(isa, "avx512bw") == 0)
+    return __builtin_cpu_supports("avx512f") &&
+           __builtin_cpu_supports("avx512bw");
+  if (strcmp(isa, "avx2") == 0)
+    return __builtin_cpu_supports("avx2");
+  if (strcmp(isa, "sse4.1") == 0)
+    return __builtin_cpu_supports("sse4.1");
+  return strcmp(isa, "sse2") == 0 || strcmp(isa, "none") == 0;
+}
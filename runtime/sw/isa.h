@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Picks between builds of a family of kernels for different instruction
+ * sets at runtime; used for the ksw2 kernels (ksw2_dispatch.cpp) and the
+ * inter-sequence kernels (intersw.cpp). Kernels is a struct whose `isa`
+ * member names the instruction set a build is for. Builds are listed
+ * widest first, ending with one that runs anywhere. The widest one the CPU
+ * supports is picked when first used, unless the environment variable
+ * names another (supported) one.
+ */
+
+// Whether the CPU supports the named instruction set ("avx512bw", "avx2",
+// "sse4.1", or the baseline "sse2" or "none").
+bool isa_supported(const char *isa);
+
+template <typename Kernels, size_t N> class ISADispatch {
+  const Kernels *const (&all)[N];
+  const char *envVar;
+  std::atomic<const Kernels *> impl;
+
+public:
+  constexpr ISADispatch(const Kernels *const (&all)[N], const char *envVar)
+      : all(all), envVar(envVar), impl(nullptr) {}
+
+  // The build for the named instruction set, or null if there is none or
+  // the CPU does not support it.
+  const Kernels *find(const char *isa) const {
+    for (const Kernels *k : all) {
+      if (strcmp(k->isa, isa) == 0)
+        return isa_supported(k->isa) ? k : nullptr;
+    }
+    return nullptr;
+  }
+
+  // Name of the i-th build the CPU supports (widest first), or null if
+  // there are no more.
+  const char *supported(size_t i) const {
+    for (const Kernels *k : all) {
+      if (isa_supported(k->isa) && i-- == 0)
+        return k->isa;
+    }
+    return nullptr;
+  }
+
+  const Kernels *get() {
+    const Kernels *k = impl.load(std::memory_order_acquire);
+    if (k)
+      return k;
+    const char *s = getenv(envVar);
+    if (s && *s) {
+      k = find(s);
+      if (!k)
+        fprintf(stderr,
+                "warning: ignoring unknown or unsupported %s value '%s'\n",
+                envVar, s);
+    }
+    if (!k) {
+      for (const Kernels *c : all) {
+        if (isa_supported(c->isa)) {
+          k = c;
+          break;
+        }
+      }
+    }
+    // threads racing here all pick the same kernels
+    impl.store(k, std::memory_order_release);
+    return k;
+  }
+
+  // Switches to the build for the named instruction set, returning false
+  // (and keeping the current one) if it is unknown or unsupported.
+  bool set(const char *isa) {
+    const Kernels *k = find(isa);
+    if (!k)
+      return false;
+    impl.store(k, std::memory_order_release);
+    return true;
+  }
+};
@@ -102,6 +102,27 @@ int ksw_gg2_sse(void *km, int qlen, const uint8_t *query, int tlen,
                 int8_t gape, int w, int *m_cigar_, int *n_cigar_,
                 uint32_t **cigar_);
 
+// The kernels above as built with KSW_CPU_DISPATCH defined, for the
+// baseline target (SSE2, or whatever the compiler flags allow);
+// ksw2_dispatch.cpp picks between these and the wider builds of
+// ksw2_simd.h at runtime.
+void ksw_extz2_sse2(void *km, int qlen, const uint8_t *query, int tlen,
+                    const uint8_t *target, int8_t m, const int8_t *mat,
+                    int8_t q, int8_t e, int w, int zdrop, int end_bonus,
+                    int flag, ksw_extz_t *ez);
+void ksw_extd2_sse2(void *km, int qlen, const uint8_t *query, int tlen,
+                    const uint8_t *target, int8_t m, const int8_t *mat,
+                    int8_t gapo, int8_t gape, int8_t gapo2, int8_t gape2,
+                    int w, int zdrop, int end_bonus, int flag, ksw_extz_t *ez);
+void ksw_exts2_sse2(void *km, int qlen, const uint8_t *query, int tlen,
+                    const uint8_t *target, int8_t m, const int8_t *mat,
+                    int8_t gapo, int8_t gape, int8_t gapo2, int8_t noncan,
+                    int zdrop, int flag, ksw_extz_t *ez);
+int ksw_gg2_sse2(void *km, int qlen, const uint8_t *query, int tlen,
+                 const uint8_t *target, int8_t m, const int8_t *mat,
+                 int8_t gapo, int8_t gape, int w, int *m_cigar_, int *n_cigar_,
+                 uint32_t **cigar_);
+
 void *ksw_ll_qinit(void *km, int size, int qlen, const uint8_t *query, int m,
                    const int8_t *mat);
 int ksw_ll_i16(void *q, int tlen, const uint8_t *target, int gapo, int gape,
@@ -119,18 +140,39 @@ extern "C" void *seq_alloc_atomic(size_t n);
 extern "C" void *seq_calloc_atomic(size_t m, size_t n);
 extern "C" void *seq_realloc(void *p, size_t n);
 extern "C" void seq_free(void *p);
-#define kmalloc(km, size) seq_alloc_atomic((size))
-#define kcalloc(km, count, size) seq_calloc_atomic((count), (size))
-#define krealloc(km, ptr, size) seq_realloc((ptr), (size))
-#define kfree(km, ptr) seq_free((ptr))
+
+// Scratch arena for the kernels' DP buffers, passed as km (nullptr takes
+// them from the GC heap). Buffers are bumped off one block and not freed
+// one by one; ksw_km_reset() recycles them all once a kernel has returned,
+// growing the block to what it needed, so an arena reused across
+// alignments stops allocating after the first few. CIGARs are always
+// allocated on the GC heap, as the caller keeps them.
+typedef struct {
+  uint8_t *buf;
+  size_t cap, used, need;
+  void **spill; // buffers that did not fit in buf
+  int n_spill, m_spill;
+} ksw_km_t;
+
+void *ksw_km_alloc(void *km, size_t size);
+void *ksw_km_calloc(void *km, size_t count, size_t size);
+void ksw_km_reset(ksw_km_t *km);
+void ksw_km_destroy(ksw_km_t *km);
+
+#define kmalloc(km, size)                                                      \
+  ((km) ? ksw_km_alloc((km), (size)) : seq_alloc_atomic((size)))
+#define kcalloc(km, count, size)                                               \
+  ((km) ? ksw_km_calloc((km), (count), (size))                                 \
+        : seq_calloc_atomic((count), (size)))
+#define kfree(km, ptr) ((km) ? (void)0 : seq_free((ptr)))
 
 static inline uint32_t *ksw_push_cigar(void *km, int *n_cigar, int *m_cigar,
                                        uint32_t *cigar, uint32_t op, int len) {
   if (*n_cigar == 0 || op != (cigar[(*n_cigar) - 1] & 0xf)) {
     if (*n_cigar == *m_cigar) {
       *m_cigar = *m_cigar ? (*m_cigar) << 1 : 4;
-      cigar = (uint32_t *)((*n_cigar) ? krealloc(km, cigar, (*m_cigar) << 2)
-                                      : kmalloc(km, (*m_cigar) << 2));
+      cigar = (uint32_t *)((*n_cigar) ? seq_realloc(cigar, (*m_cigar) << 2)
+                                      : seq_alloc_atomic((*m_cigar) << 2));
     }
     cigar[(*n_cigar)++] = len << 4 | op;
   } else
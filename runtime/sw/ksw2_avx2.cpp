@@ -0,0 +1,5 @@
+// AVX2 build of the ksw2 kernels (see ksw2_simd.h)
+#define KSW2_ISA ksw2_avx2
+#include "ksw2_simd.h"
+
+extern const KSW2Kernels ksw2_avx2_kernels = ksw2_avx2::kernels<256>("avx2");
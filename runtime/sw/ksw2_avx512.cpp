@@ -0,0 +1,6 @@
+// AVX-512BW build of the ksw2 kernels (see ksw2_simd.h)
+#define KSW2_ISA ksw2_avx512
+#include "ksw2_simd.h"
+
+extern const KSW2Kernels ksw2_avx512_kernels =
+    ksw2_avx512::kernels<512>("avx512bw");
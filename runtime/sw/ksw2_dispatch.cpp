@@ -0,0 +1,80 @@
+#include "isa.h"
+#include "ksw2.h"
+#include "ksw2_simd.h"
+#include "lib.h"
+
+/*
+ * The ksw2 kernels are built for SSE2 (ksw2_*_sse.cpp, compiled with
+ * KSW_CPU_DISPATCH) and for SSE4.1, AVX2 and AVX-512BW (ksw2_simd.h); all of
+ * them give the same results. The widest one the CPU supports is picked when
+ * first used. Setting the SEQ_ALIGN_ISA environment variable (or calling
+ * seq_align_set_isa) to an instruction set's name picks a narrower one
+ * instead, e.g. to compare them. The ksw_*_sse functions the rest of the
+ * runtime calls forward to the kernels picked.
+ */
+#define SEQ_ALIGN_ISA_ENV_VAR "SEQ_ALIGN_ISA"
+
+extern const KSW2Kernels ksw2_sse41_kernels;
+extern const KSW2Kernels ksw2_avx2_kernels;
+extern const KSW2Kernels ksw2_avx512_kernels;
+
+static const KSW2Kernels ksw2_sse2_kernels = {
+    "sse2", ksw_extz2_sse2, ksw_extd2_sse2, ksw_exts2_sse2, ksw_gg2_sse2};
+
+// widest first
+static const KSW2Kernels *const ksw2_all[] = {
+    &ksw2_avx512_kernels, &ksw2_avx2_kernels, &ksw2_sse41_kernels,
+    &ksw2_sse2_kernels};
+
+static ISADispatch<KSW2Kernels, 4> ksw2_dispatch(ksw2_all,
+                                                 SEQ_ALIGN_ISA_ENV_VAR);
+
+static const KSW2Kernels *ksw2_kernels() { return ksw2_dispatch.get(); }
+
+// Name of the instruction set of the kernels in use ("avx512bw", "avx2",
+// "sse4.1" or "sse2").
+SEQ_FUNC const char *seq_align_isa() { return ksw2_kernels()->isa; }
+
+// Name of the i-th instruction set the CPU has kernels for (widest first),
+// or null if there are no more.
+SEQ_FUNC const char *seq_align_isas(seq_int_t i) {
+  return ksw2_dispatch.supported(i);
+}
+
+// Switches to the kernels of the given instruction set, returning false
+// (and keeping the current ones) if it is unknown or unsupported.
+SEQ_FUNC bool seq_align_set_isa(const char *isa) {
+  return ksw2_dispatch.set(isa);
+}
+
+void ksw_extz2_sse(void *km, int qlen, const uint8_t *query, int tlen,
+                   const uint8_t *target, int8_t m, const int8_t *mat, int8_t q,
+                   int8_t e, int w, int zdrop, int end_bonus, int flag,
+                   ksw_extz_t *ez) {
+  ksw2_kernels()->extz2(km, qlen, query, tlen, target, m, mat, q, e, w, zdrop,
+                        end_bonus, flag, ez);
+}
+
+void ksw_extd2_sse(void *km, int qlen, const uint8_t *query, int tlen,
+                   const uint8_t *target, int8_t m, const int8_t *mat,
+                   int8_t q, int8_t e, int8_t q2, int8_t e2, int w, int zdrop,
+                   int end_bonus, int flag, ksw_extz_t *ez) {
+  ksw2_kernels()->extd2(km, qlen, query, tlen, target, m, mat, q, e, q2, e2, w,
+                        zdrop, end_bonus, flag, ez);
+}
+
+void ksw_exts2_sse(void *km, int qlen, const uint8_t *query, int tlen,
+                   const uint8_t *target, int8_t m, const int8_t *mat,
+                   int8_t q, int8_t e, int8_t q2, int8_t noncan, int zdrop,
+                   int flag, ksw_extz_t *ez) {
+  ksw2_kernels()->exts2(km, qlen, query, tlen, target, m, mat, q, e, q2,
+                        noncan, zdrop, flag, ez);
+}
+
+int ksw_gg2_sse(void *km, int qlen, const uint8_t *query, int tlen,
+                const uint8_t *target, int8_t m, const int8_t *mat, int8_t q,
+                int8_t e, int w, int *m_cigar_, int *n_cigar_,
+                uint32_t **cigar_) {
+  return ksw2_kernels()->gg2(km, qlen, query, tlen, target, m, mat, q, e, w,
+                             m_cigar_, n_cigar_, cigar_);
+}
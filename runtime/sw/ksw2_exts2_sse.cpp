@@ -14,17 +14,10 @@
 #endif
 
 #ifdef KSW_CPU_DISPATCH
-#ifdef __SSE4_1__
-void ksw_exts2_sse41(void *km, int qlen, const uint8_t *query, int tlen,
-                     const uint8_t *target, int8_t m, const int8_t *mat,
-                     int8_t q, int8_t e, int8_t q2, int8_t noncan, int zdrop,
-                     int flag, ksw_extz_t *ez)
-#else
 void ksw_exts2_sse2(void *km, int qlen, const uint8_t *query, int tlen,
                     const uint8_t *target, int8_t m, const int8_t *mat,
                     int8_t q, int8_t e, int8_t q2, int8_t noncan, int zdrop,
                     int flag, ksw_extz_t *ez)
-#endif
 #else
 void ksw_exts2_sse(void *km, int qlen, const uint8_t *query, int tlen,
                    const uint8_t *target, int8_t m, const int8_t *mat, int8_t q,
@@ -223,7 +216,7 @@ void ksw_exts2_sse(void *km, int qlen, const uint8_t *query, int tlen,
     assert(en_ - st_ + 1 <= n_col_);
     if (!with_cigar) { // score only
       for (t = st_; t <= en_; ++t) {
-        __m128i z, a, b, a2, a2a, xt1, x2t1, vt1, ut, tmp;
+        __m128i z, a, b, a2, a2a, xt1, x2t1, vt1, ut, tmp, tmp2;
         __dp_code_block1;
 #ifdef __SSE4_1__
         z = _mm_max_epi8(z, a);
@@ -246,9 +239,9 @@ void ksw_exts2_sse(void *km, int qlen, const uint8_t *query, int tlen,
         _mm_store_si128(&x[t], _mm_sub_epi8(_mm_and_si128(tmp, a), qe_));
         tmp = _mm_cmpgt_epi8(b, zero_);
         _mm_store_si128(&y[t], _mm_sub_epi8(_mm_and_si128(tmp, b), qe_));
-        tmp = _mm_load_si128(&donor[t]); // TODO: check if this is correct
-        tmp = _mm_cmpgt_epi8(a2, tmp);
-        tmp = _mm_or_si128(_mm_andnot_si128(tmp, tmp), _mm_and_si128(tmp, a2));
+        tmp2 = _mm_load_si128(&donor[t]);
+        tmp = _mm_cmpgt_epi8(a2, tmp2);
+        tmp = _mm_or_si128(_mm_andnot_si128(tmp, tmp2), _mm_and_si128(tmp, a2));
         _mm_store_si128(&x2[t], _mm_sub_epi8(tmp, q2_));
 #endif
       }
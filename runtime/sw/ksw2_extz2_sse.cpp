@@ -14,17 +14,10 @@
 #endif
 
 #ifdef KSW_CPU_DISPATCH
-#ifdef __SSE4_1__
-void ksw_extz2_sse41(void *km, int qlen, const uint8_t *query, int tlen,
-                     const uint8_t *target, int8_t m, const int8_t *mat,
-                     int8_t q, int8_t e, int w, int zdrop, int end_bonus,
-                     int flag, ksw_extz_t *ez)
-#else
 void ksw_extz2_sse2(void *km, int qlen, const uint8_t *query, int tlen,
                     const uint8_t *target, int8_t m, const int8_t *mat,
                     int8_t q, int8_t e, int w, int zdrop, int end_bonus,
                     int flag, ksw_extz_t *ez)
-#endif
 #else
 void ksw_extz2_sse(void *km, int qlen, const uint8_t *query, int tlen,
                    const uint8_t *target, int8_t m, const int8_t *mat, int8_t q,
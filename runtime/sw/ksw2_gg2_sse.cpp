@@ -8,10 +8,18 @@
 #include <smmintrin.h>
 #endif
 
+#ifdef KSW_CPU_DISPATCH
+int ksw_gg2_sse2(void *km, int qlen, const uint8_t *query, int tlen,
+                 const uint8_t *target, int8_t m, const int8_t *mat, int8_t q,
+                 int8_t e, int w, int *m_cigar_, int *n_cigar_,
+                 uint32_t **cigar_)
+#else
 int ksw_gg2_sse(void *km, int qlen, const uint8_t *query, int tlen,
                 const uint8_t *target, int8_t m, const int8_t *mat, int8_t q,
                 int8_t e, int w, int *m_cigar_, int *n_cigar_,
-                uint32_t **cigar_) {
+                uint32_t **cigar_)
+#endif // ~KSW_CPU_DISPATCH
+{
   int r, t, n_col, n_col_, *off, tlen_, last_st, last_en, H0 = 0, last_H0_t = 0;
   uint8_t *qr, *mem, *mem2;
   __m128i *u, *v, *x, *y, *s, *p;
@@ -0,0 +1,62 @@
+#include "ksw2.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// buffers start on cache lines, which also covers the kernels' 16-byte
+// alignment
+#define KSW_KM_ALIGN 64
+
+static void *ksw_km_aligned(size_t size) {
+  void *p = aligned_alloc(KSW_KM_ALIGN, size);
+  if (!p) {
+    fprintf(stderr, "error: out of memory for alignment buffers\n");
+    abort();
+  }
+  return p;
+}
+
+void *ksw_km_alloc(void *km_, size_t size) {
+  ksw_km_t *km = (ksw_km_t *)km_;
+  size = (size + KSW_KM_ALIGN - 1) / KSW_KM_ALIGN * KSW_KM_ALIGN;
+  if (size == 0)
+    size = KSW_KM_ALIGN;
+  km->need += size;
+  if (km->used + size <= km->cap) {
+    void *p = km->buf + km->used;
+    km->used += size;
+    return p;
+  }
+  if (km->n_spill == km->m_spill) {
+    km->m_spill = km->m_spill ? km->m_spill << 1 : 8;
+    km->spill = (void **)realloc(km->spill, km->m_spill * sizeof(void *));
+  }
+  void *p = ksw_km_aligned(size);
+  km->spill[km->n_spill++] = p;
+  return p;
+}
+
+void *ksw_km_calloc(void *km, size_t count, size_t size) {
+  void *p = ksw_km_alloc(km, count * size);
+  memset(p, 0, count * size);
+  return p;
+}
+
+void ksw_km_reset(ksw_km_t *km) {
+  for (int i = 0; i < km->n_spill; i++)
+    free(km->spill[i]);
+  km->n_spill = 0;
+  if (km->need > km->cap) {
+    free(km->buf);
+    km->buf = (uint8_t *)ksw_km_aligned(km->need);
+    km->cap = km->need;
+  }
+  km->used = km->need = 0;
+}
+
+void ksw_km_destroy(ksw_km_t *km) {
+  ksw_km_reset(km);
+  free(km->buf);
+  free(km->spill);
+  memset(km, 0, sizeof(*km));
+}
@@ -0,0 +1,1288 @@
+// ksw2 kernels (ksw_extz2_sse, ksw_extd2_sse, ksw_exts2_sse and
+// ksw_gg2_sse) for vectors of any width
+//
+// These follow the SSE kernels step for step, and compute exactly what they
+// do. In particular, anti-diagonals are still split into 16-byte blocks:
+// which cells around the band get computed (from whatever scores they hold)
+// depends on where blocks start and end, and those cells feed into the
+// cells at the edges of the band. A vector just covers several consecutive
+// blocks, and the last vector of an anti-diagonal only stores the blocks
+// that belong to it. Likewise, the exact maximum of an anti-diagonal is
+// found with more 32-bit lanes, which are then merged as if there had been
+// four of them, so that ties go to the same cell.
+//
+// The kernels are compiled once per instruction set, each time by a source
+// file that defines KSW2_ISA (the namespace to put that build in) and is
+// compiled with the matching target flags; ksw2_dispatch.cpp picks one at
+// runtime. Code shared by all builds goes above the namespace.
+#pragma once
+
+#include "ksw2.h"
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+typedef void (*ksw_extz2_fn_t)(void *, int, const uint8_t *, int,
+                               const uint8_t *, int8_t, const int8_t *, int8_t,
+                               int8_t, int, int, int, int, ksw_extz_t *);
+typedef void (*ksw_extd2_fn_t)(void *, int, const uint8_t *, int,
+                               const uint8_t *, int8_t, const int8_t *, int8_t,
+                               int8_t, int8_t, int8_t, int, int, int, int,
+                               ksw_extz_t *);
+typedef void (*ksw_exts2_fn_t)(void *, int, const uint8_t *, int,
+                               const uint8_t *, int8_t, const int8_t *, int8_t,
+                               int8_t, int8_t, int8_t, int, int, ksw_extz_t *);
+typedef int (*ksw_gg2_fn_t)(void *, int, const uint8_t *, int, const uint8_t *,
+                            int8_t, const int8_t *, int8_t, int8_t, int, int *,
+                            int *, uint32_t **);
+
+// kernels built for one instruction set
+struct KSW2Kernels {
+  const char *isa;
+  ksw_extz2_fn_t extz2;
+  ksw_extd2_fn_t extd2;
+  ksw_exts2_fn_t exts2;
+  ksw_gg2_fn_t gg2;
+};
+
+#ifdef KSW2_ISA
+namespace KSW2_ISA {
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+// Vectors of W bits: 8-bit lanes for the DP, 32-bit lanes for the exact
+// maximum. Cmp/Cmp32 are comparison results (vectors, or AVX-512 masks).
+template <unsigned W> struct KswVec {};
+
+template <> struct KswVec<128> {
+  using Vec = __m128i;
+  using Cmp = __m128i;
+  using Vec32 = __m128i;
+  using Cmp32 = __m128i;
+  static constexpr int BLOCKS = 1; // 16-byte blocks per vector
+  static constexpr int LANES32 = 4;
+
+  static inline Vec set(int8_t n) { return _mm_set1_epi8(n); }
+  static inline Vec load(const void *p) {
+    return _mm_loadu_si128((const __m128i *)p);
+  }
+  static inline void store(void *p, Vec v) { _mm_storeu_si128((__m128i *)p, v); }
+  // stores the first n blocks of v
+  static inline void store(void *p, Vec v, int n) { store(p, v); }
+  static inline Vec add(Vec a, Vec b) { return _mm_add_epi8(a, b); }
+  static inline Vec sub(Vec a, Vec b) { return _mm_sub_epi8(a, b); }
+  static inline Vec max(Vec a, Vec b) { return _mm_max_epi8(a, b); }
+  static inline Vec min(Vec a, Vec b) { return _mm_min_epi8(a, b); }
+  static inline Vec umax(Vec a, Vec b) { return _mm_max_epu8(a, b); }
+  static inline Vec umin(Vec a, Vec b) { return _mm_min_epu8(a, b); }
+  static inline Vec or_(Vec a, Vec b) { return _mm_or_si128(a, b); }
+  static inline Cmp gt(Vec a, Vec b) { return _mm_cmpgt_epi8(a, b); }
+  static inline Cmp eq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+  static inline Cmp cor(Cmp a, Cmp b) { return _mm_or_si128(a, b); }
+  // c ? b : a
+  static inline Vec blend(Cmp c, Vec a, Vec b) {
+    return _mm_blendv_epi8(a, b, c);
+  }
+  // c ? a : 0
+  static inline Vec keep(Cmp c, Vec a) { return _mm_and_si128(c, a); }
+  // c ? 0 : a
+  static inline Vec drop(Cmp c, Vec a) { return _mm_andnot_si128(c, a); }
+  // v moved up by one byte, with the last byte of prev moved in
+  static inline Vec shift_in(Vec v, Vec prev) {
+    return _mm_alignr_epi8(v, prev, 15);
+  }
+
+  static inline Vec32 set32(int32_t n) { return _mm_set1_epi32(n); }
+  static inline Vec32 index32() { return _mm_setr_epi32(0, 1, 2, 3); }
+  static inline Vec32 load32(const int32_t *p) {
+    return _mm_loadu_si128((const __m128i *)p);
+  }
+  static inline void store32(int32_t *p, Vec32 v) {
+    _mm_storeu_si128((__m128i *)p, v);
+  }
+  static inline Cmp32 first32(int n) {
+    return _mm_cmpgt_epi32(set32(n), index32());
+  }
+  static inline Vec32 load32(const int32_t *p, Cmp32 k) {
+    return _mm_and_si128(k, load32(p));
+  }
+  static inline void store32(int32_t *p, Vec32 v, Cmp32 k) {
+    store32(p, _mm_blendv_epi8(load32(p), v, k));
+  }
+  static inline Vec32 widen(const int8_t *p) {
+    int32_t n;
+    memcpy(&n, p, sizeof(n));
+    return _mm_cvtepi8_epi32(_mm_cvtsi32_si128(n));
+  }
+  static inline Vec32 widen(const uint8_t *p) {
+    int32_t n;
+    memcpy(&n, p, sizeof(n));
+    return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(n));
+  }
+  static inline Vec32 add32(Vec32 a, Vec32 b) { return _mm_add_epi32(a, b); }
+  static inline Cmp32 gt32(Vec32 a, Vec32 b) { return _mm_cmpgt_epi32(a, b); }
+  static inline Cmp32 cand32(Cmp32 a, Cmp32 b) { return _mm_and_si128(a, b); }
+  static inline Vec32 blend32(Cmp32 c, Vec32 a, Vec32 b) {
+    return _mm_blendv_epi8(a, b, c);
+  }
+};
+
+#ifdef __AVX2__
+template <> struct KswVec<256> {
+  using Vec = __m256i;
+  using Cmp = __m256i;
+  using Vec32 = __m256i;
+  using Cmp32 = __m256i;
+  static constexpr int BLOCKS = 2;
+  static constexpr int LANES32 = 8;
+
+  static inline Vec set(int8_t n) { return _mm256_set1_epi8(n); }
+  static inline Vec load(const void *p) {
+    return _mm256_loadu_si256((const __m256i *)p);
+  }
+  static inline void store(void *p, Vec v) {
+    _mm256_storeu_si256((__m256i *)p, v);
+  }
+  static inline void store(void *p, Vec v, int n) {
+    if (n >= BLOCKS)
+      store(p, v);
+    else
+      _mm_storeu_si128((__m128i *)p, _mm256_castsi256_si128(v));
+  }
+  static inline Vec add(Vec a, Vec b) { return _mm256_add_epi8(a, b); }
+  static inline Vec sub(Vec a, Vec b) { return _mm256_sub_epi8(a, b); }
+  static inline Vec max(Vec a, Vec b) { return _mm256_max_epi8(a, b); }
+  static inline Vec min(Vec a, Vec b) { return _mm256_min_epi8(a, b); }
+  static inline Vec umax(Vec a, Vec b) { return _mm256_max_epu8(a, b); }
+  static inline Vec umin(Vec a, Vec b) { return _mm256_min_epu8(a, b); }
+  static inline Vec or_(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+  static inline Cmp gt(Vec a, Vec b) { return _mm256_cmpgt_epi8(a, b); }
+  static inline Cmp eq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+  static inline Cmp cor(Cmp a, Cmp b) { return _mm256_or_si256(a, b); }
+  static inline Vec blend(Cmp c, Vec a, Vec b) {
+    return _mm256_blendv_epi8(a, b, c);
+  }
+  static inline Vec keep(Cmp c, Vec a) { return _mm256_and_si256(c, a); }
+  static inline Vec drop(Cmp c, Vec a) { return _mm256_andnot_si256(c, a); }
+  static inline Vec shift_in(Vec v, Vec prev) {
+    // lanes: last of prev, first of v
+    return _mm256_alignr_epi8(v, _mm256_permute2x128_si256(prev, v, 0x21),
+                              15);
+  }
+
+  static inline Vec32 set32(int32_t n) { return _mm256_set1_epi32(n); }
+  static inline Vec32 index32() {
+    return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  }
+  static inline Vec32 load32(const int32_t *p) {
+    return _mm256_loadu_si256((const __m256i *)p);
+  }
+  static inline void store32(int32_t *p, Vec32 v) {
+    _mm256_storeu_si256((__m256i *)p, v);
+  }
+  static inline Cmp32 first32(int n) {
+    return _mm256_cmpgt_epi32(set32(n), index32());
+  }
+  static inline Vec32 load32(const int32_t *p, Cmp32 k) {
+    return _mm256_maskload_epi32(p, k);
+  }
+  static inline void store32(int32_t *p, Vec32 v, Cmp32 k) {
+    _mm256_maskstore_epi32(p, k, v);
+  }
+  static inline Vec32 widen(const int8_t *p) {
+    return _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)p));
+  }
+  static inline Vec32 widen(const uint8_t *p) {
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+  }
+  static inline Vec32 add32(Vec32 a, Vec32 b) { return _mm256_add_epi32(a, b); }
+  static inline Cmp32 gt32(Vec32 a, Vec32 b) {
+    return _mm256_cmpgt_epi32(a, b);
+  }
+  static inline Cmp32 cand32(Cmp32 a, Cmp32 b) { return _mm256_and_si256(a, b); }
+  static inline Vec32 blend32(Cmp32 c, Vec32 a, Vec32 b) {
+    return _mm256_blendv_epi8(a, b, c);
+  }
+};
+#endif
+
+#ifdef __AVX512BW__
+template <> struct KswVec<512> {
+  using Vec = __m512i;
+  using Cmp = __mmask64;
+  using Vec32 = __m512i;
+  using Cmp32 = __mmask16;
+  static constexpr int BLOCKS = 4;
+  static constexpr int LANES32 = 16;
+
+  static inline Vec set(int8_t n) { return _mm512_set1_epi8(n); }
+  static inline Vec load(const void *p) { return _mm512_loadu_si512(p); }
+  static inline void store(void *p, Vec v) { _mm512_storeu_si512(p, v); }
+  static inline void store(void *p, Vec v, int n) {
+    if (n >= BLOCKS)
+      store(p, v);
+    else
+      _mm512_mask_storeu_epi64(p, (__mmask8)((1u << (2 * n)) - 1), v);
+  }
+  static inline Vec add(Vec a, Vec b) { return _mm512_add_epi8(a, b); }
+  static inline Vec sub(Vec a, Vec b) { return _mm512_sub_epi8(a, b); }
+  static inline Vec max(Vec a, Vec b) { return _mm512_max_epi8(a, b); }
+  static inline Vec min(Vec a, Vec b) { return _mm512_min_epi8(a, b); }
+  static inline Vec umax(Vec a, Vec b) { return _mm512_max_epu8(a, b); }
+  static inline Vec umin(Vec a, Vec b) { return _mm512_min_epu8(a, b); }
+  static inline Vec or_(Vec a, Vec b) { return _mm512_or_si512(a, b); }
+  static inline Cmp gt(Vec a, Vec b) { return _mm512_cmpgt_epi8_mask(a, b); }
+  static inline Cmp eq(Vec a, Vec b) { return _mm512_cmpeq_epi8_mask(a, b); }
+  static inline Cmp cor(Cmp a, Cmp b) { return a | b; }
+  static inline Vec blend(Cmp c, Vec a, Vec b) {
+    return _mm512_mask_blend_epi8(c, a, b);
+  }
+  static inline Vec keep(Cmp c, Vec a) { return _mm512_maskz_mov_epi8(c, a); }
+  static inline Vec drop(Cmp c, Vec a) { return _mm512_maskz_mov_epi8(~c, a); }
+  static inline Vec shift_in(Vec v, Vec prev) {
+    // 128-bit lanes: last of prev, first three of v
+    return _mm512_alignr_epi8(v, _mm512_alignr_epi64(v, prev, 6), 15);
+  }
+
+  static inline Vec32 set32(int32_t n) { return _mm512_set1_epi32(n); }
+  static inline Vec32 index32() {
+    return _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+                             15);
+  }
+  static inline Vec32 load32(const int32_t *p) { return _mm512_loadu_si512(p); }
+  static inline void store32(int32_t *p, Vec32 v) { _mm512_storeu_si512(p, v); }
+  static inline Cmp32 first32(int n) { return (Cmp32)((1u << n) - 1); }
+  static inline Vec32 load32(const int32_t *p, Cmp32 k) {
+    return _mm512_maskz_loadu_epi32(k, p);
+  }
+  static inline void store32(int32_t *p, Vec32 v, Cmp32 k) {
+    _mm512_mask_storeu_epi32(p, k, v);
+  }
+  static inline Vec32 widen(const int8_t *p) {
+    return _mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i *)p));
+  }
+  static inline Vec32 widen(const uint8_t *p) {
+    return _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)p));
+  }
+  static inline Vec32 add32(Vec32 a, Vec32 b) { return _mm512_add_epi32(a, b); }
+  static inline Cmp32 gt32(Vec32 a, Vec32 b) {
+    return _mm512_cmpgt_epi32_mask(a, b);
+  }
+  static inline Cmp32 cand32(Cmp32 a, Cmp32 b) { return a & b; }
+  static inline Vec32 blend32(Cmp32 c, Vec32 a, Vec32 b) {
+    return _mm512_mask_blend_epi32(c, a, b);
+  }
+};
+#endif
+
+// address of 16-byte block t
+#define KSW_BLK(p, t) ((p) + (size_t)(t)*16)
+
+// Scores of the cells st0..en0 of an anti-diagonal (see the SSE kernels),
+// written in 16-byte steps from st0 on, as they are there.
+template <class V>
+static inline void ksw_set_scores(uint8_t *s, const uint8_t *sf,
+                                  const uint8_t *qrr, int st0, int en0,
+                                  typename V::Vec sc_mch_,
+                                  typename V::Vec sc_mis_,
+                                  typename V::Vec sc_N_, typename V::Vec m1_) {
+  for (int t = st0; t <= en0; t += V::BLOCKS * 16) {
+    typename V::Vec sq = V::load(&sf[t]), st = V::load(&qrr[t]);
+    typename V::Cmp mask = V::cor(V::eq(sq, m1_), V::eq(st, m1_));
+    typename V::Vec tmp = V::blend(V::eq(sq, st), sc_mis_, sc_mch_);
+    V::store(&s[t], V::blend(mask, tmp, sc_N_), (en0 - t + 16) / 16);
+  }
+}
+
+// Adds d[t] + c to H[t] for t in [st0, en0), and updates max_H and max_t
+// (initially the last cell) with the maximum. The SSE kernels keep a
+// maximum per cell index mod 4 up to en1 and take the first of those four
+// that beats max_H; more lanes are merged back into four to do the same.
+template <class V, typename D>
+static inline void ksw_row_max(int32_t *H, const D *d, int32_t c, int st0,
+                               int en0, int32_t &max_H, int32_t &max_t) {
+  using Vec32 = typename V::Vec32;
+  using Cmp32 = typename V::Cmp32;
+  const int en1 = st0 + (en0 - st0) / 4 * 4;
+  const Vec32 c_ = V::set32(c), index_ = V::index32();
+  Vec32 max_H_ = V::set32(max_H), max_t_ = V::set32(max_t);
+  int t = st0;
+  for (; t + V::LANES32 <= en1; t += V::LANES32) {
+    Vec32 H1 = V::add32(V::add32(V::load32(&H[t]), V::widen(&d[t])), c_);
+    V::store32(&H[t], H1);
+    Cmp32 gt = V::gt32(H1, max_H_);
+    max_H_ = V::blend32(gt, max_H_, H1);
+    max_t_ = V::blend32(gt, max_t_, V::add32(V::set32(t), index_));
+  }
+  if (t < en1) { // a multiple of 4 cells, but less than a vector
+    Cmp32 k = V::first32(en1 - t);
+    Vec32 H1 = V::add32(V::add32(V::load32(&H[t], k), V::widen(&d[t])), c_);
+    V::store32(&H[t], H1, k);
+    Cmp32 gt = V::cand32(V::gt32(H1, max_H_), k);
+    max_H_ = V::blend32(gt, max_H_, H1);
+    max_t_ = V::blend32(gt, max_t_, V::add32(V::set32(t), index_));
+    t = en1;
+  }
+  int32_t HH[V::LANES32], tt[V::LANES32];
+  V::store32(HH, max_H_);
+  V::store32(tt, max_t_);
+  for (int i = 0; i < 4; ++i) {
+    int32_t h = HH[i], ht = tt[i];
+    for (int j = i + 4; j < V::LANES32; j += 4) // first cell with the max
+      if (HH[j] > h || (HH[j] == h && tt[j] < ht))
+        h = HH[j], ht = tt[j];
+    if (max_H < h)
+      max_H = h, max_t = ht;
+  }
+  for (; t < en0; ++t) {
+    H[t] += (int32_t)d[t] + c;
+    if (H[t] > max_H)
+      max_H = H[t], max_t = t;
+  }
+}
+
+template <class V>
+void extz2(void *km, int qlen, const uint8_t *query, int tlen,
+           const uint8_t *target, int8_t m, const int8_t *mat, int8_t q,
+           int8_t e, int w, int zdrop, int end_bonus, int flag,
+           ksw_extz_t *ez) {
+  using Vec = typename V::Vec;
+  using Cmp = typename V::Cmp;
+  int r, t, qe = q + e, n_col_, *off = 0, *off_end = 0, tlen_, qlen_, last_st,
+            last_en, wl, wr, max_sc, min_sc;
+  int with_cigar = !(flag & KSW_EZ_SCORE_ONLY),
+      approx_max = !!(flag & KSW_EZ_APPROX_MAX);
+  int32_t *H = 0, H0 = 0, last_H0_t = 0;
+  uint8_t *qr, *sf, *mem, *mem2 = 0;
+  uint8_t *u, *v, *x, *y, *s, *p = 0;
+
+  ksw_reset_extz(ez);
+  if (m <= 0 || qlen <= 0 || tlen <= 0)
+    return;
+
+  const Vec zero_ = V::set(0), q_ = V::set(q), qe2_ = V::set((q + e) * 2),
+            flag1_ = V::set(1), flag2_ = V::set(2), flag8_ = V::set(0x08),
+            flag16_ = V::set(0x10), sc_mch_ = V::set(mat[0]),
+            sc_mis_ = V::set(mat[1]),
+            sc_N_ = V::set(mat[m * m - 1] == 0 ? -e : mat[m * m - 1]),
+            m1_ = V::set(m - 1), max_sc_ = V::set(mat[0] + (q + e) * 2);
+
+  if (w < 0)
+    w = tlen > qlen ? tlen : qlen;
+  wl = wr = w;
+  tlen_ = (tlen + 15) / 16;
+  n_col_ = qlen < tlen ? qlen : tlen;
+  n_col_ = ((n_col_ < w + 1 ? n_col_ : w + 1) + 15) / 16 + 1;
+  qlen_ = (qlen + 15) / 16;
+  for (t = 1, max_sc = mat[0], min_sc = mat[1]; t < m * m; ++t) {
+    max_sc = max_sc > mat[t] ? max_sc : mat[t];
+    min_sc = min_sc < mat[t] ? min_sc : mat[t];
+  }
+  if (-min_sc > 2 * (q + e))
+    return; // otherwise, we won't see any mismatches
+
+  // vectors may read up to BLOCKS - 1 blocks past the arrays
+  mem = (uint8_t *)kcalloc(km, tlen_ * 6 + qlen_ + V::BLOCKS, 16);
+  u = (uint8_t *)(((size_t)mem + 15) >> 4 << 4); // 16-byte aligned
+  v = KSW_BLK(u, tlen_), x = KSW_BLK(v, tlen_), y = KSW_BLK(x, tlen_),
+  s = KSW_BLK(y, tlen_), sf = KSW_BLK(s, tlen_), qr = sf + tlen_ * 16;
+  if (!approx_max) {
+    H = (int32_t *)kmalloc(km, tlen_ * 16 * 4);
+    for (t = 0; t < tlen_ * 16; ++t)
+      H[t] = KSW_NEG_INF;
+  }
+  if (with_cigar) {
+    mem2 =
+        (uint8_t *)kmalloc(km, ((size_t)(qlen + tlen - 1) * n_col_ + 1) * 16);
+    p = (uint8_t *)(((size_t)mem2 + 15) >> 4 << 4);
+    off = (int *)kmalloc(km, (qlen + tlen - 1) * sizeof(int) * 2);
+    off_end = off + qlen + tlen - 1;
+  }
+
+  for (t = 0; t < qlen; ++t)
+    qr[t] = query[qlen - 1 - t];
+  memcpy(sf, target, tlen);
+
+  for (r = 0, last_st = last_en = -1; r < qlen + tlen - 1; ++r) {
+    int st = 0, en = tlen - 1, st0, en0, st_, en_;
+    int8_t x1, v1;
+    uint8_t *qrr = qr + (qlen - 1 - r), *u8 = u, *v8 = v;
+    Vec x1_, v1_;
+    // find the boundaries
+    if (st < r - qlen + 1)
+      st = r - qlen + 1;
+    if (en > r)
+      en = r;
+    if (st < ((r - wr + 1) >> 1))
+      st = (r - wr + 1) >> 1; // take the ceil
+    if (en > (r + wl) >> 1)
+      en = (r + wl) >> 1; // take the floor
+    if (st > en) {
+      ez->zdropped = 1;
+      break;
+    }
+    st0 = st, en0 = en;
+    st = st / 16 * 16, en = (en + 16) / 16 * 16 - 1;
+    // set boundary conditions
+    if (st > 0) {
+      if (st - 1 >= last_st && st - 1 <= last_en)
+        x1 = x[st - 1], v1 = v8[st - 1]; // (r-1,s-1) calculated in the last
+                                         // round
+      else
+        x1 = v1 = 0; // not calculated; set to zeros
+    } else
+      x1 = 0, v1 = r ? q : 0;
+    if (en >= r)
+      y[r] = 0, u8[r] = r ? q : 0;
+    // loop fission: set scores first
+    if (!(flag & KSW_EZ_GENERIC_SC))
+      ksw_set_scores<V>(s, sf, qrr, st0, en0, sc_mch_, sc_mis_, sc_N_, m1_);
+    else
+      for (t = st0; t <= en0; ++t)
+        s[t] = mat[sf[t] * m + qrr[t]];
+    // core loop; x1_ and v1_ hold the last cells of the previous vector
+    x1_ = V::set(x1);
+    v1_ = V::set(v1);
+    st_ = st / 16, en_ = en / 16;
+    assert(en_ - st_ + 1 <= n_col_);
+    uint8_t *pr = with_cigar ? KSW_BLK(p, (size_t)r * n_col_ - st_) : nullptr;
+    if (with_cigar)
+      off[r] = st, off_end[r] = en;
+    for (t = st_; t <= en_; t += V::BLOCKS) {
+      const int n = en_ - t + 1; // blocks left
+      Vec z, a, b, xt1, vt1, ut, d;
+      z = V::add(V::load(KSW_BLK(s, t)), qe2_);
+      xt1 = V::load(KSW_BLK(x, t)); // xt1 <- x[r-1][t..t+W-1]
+      a = V::shift_in(xt1, x1_);    // a <- x[r-1][t-1..t+W-2]
+      x1_ = xt1;
+      xt1 = a;
+      vt1 = V::load(KSW_BLK(v, t)); // vt1 <- v[r-1][t..t+W-1]
+      a = V::shift_in(vt1, v1_);    // a <- v[r-1][t-1..t+W-2]
+      v1_ = vt1;
+      vt1 = a;
+      a = V::add(xt1, vt1); // a <- x[r-1][t-1..] + v[r-1][t-1..]
+      ut = V::load(KSW_BLK(u, t));                  // ut <- u[t..t+W-1]
+      b = V::add(V::load(KSW_BLK(y, t)), ut);       // b <- y[r-1][t..] + u[r-1][t..]
+      if (!with_cigar) { // score only
+        z = V::max(z, a);
+      } else if (!(flag & KSW_EZ_RIGHT)) { // gap left-alignment
+        d = V::keep(V::gt(a, z), flag1_);  // d = a > z? 1 : 0
+        z = V::max(z, a);
+        d = V::blend(V::gt(b, z), d, flag2_); // d = b > z? 2 : d
+      } else {                                // gap right-alignment
+        d = V::drop(V::gt(z, a), flag1_);     // d = z > a? 0 : 1
+        z = V::max(z, a);
+        d = V::blend(V::gt(z, b), flag2_, d); // d = z > b? d : 2
+      }
+      z = V::umax(z, b); // this works because both are non-negative
+      z = V::umin(z, max_sc_);
+      V::store(KSW_BLK(u, t), V::sub(z, vt1), n); // u[r][t..] <- z - v[r-1][t-1..]
+      V::store(KSW_BLK(v, t), V::sub(z, ut), n);  // v[r][t..] <- z - u[r-1][t..]
+      z = V::sub(z, q_);
+      a = V::sub(a, z);
+      b = V::sub(b, z);
+      if (!with_cigar) {
+        V::store(KSW_BLK(x, t), V::max(a, zero_), n);
+        V::store(KSW_BLK(y, t), V::max(b, zero_), n);
+      } else if (!(flag & KSW_EZ_RIGHT)) {
+        Cmp tmp = V::gt(a, zero_);
+        V::store(KSW_BLK(x, t), V::keep(tmp, a), n);
+        d = V::or_(d, V::keep(tmp, flag8_)); // d = a > 0? 0x08 : 0
+        tmp = V::gt(b, zero_);
+        V::store(KSW_BLK(y, t), V::keep(tmp, b), n);
+        d = V::or_(d, V::keep(tmp, flag16_)); // d = b > 0? 0x10 : 0
+        V::store(KSW_BLK(pr, t), d, n);
+      } else {
+        Cmp tmp = V::gt(zero_, a);
+        V::store(KSW_BLK(x, t), V::drop(tmp, a), n);
+        d = V::or_(d, V::drop(tmp, flag8_)); // d = 0 > a? 0 : 0x08
+        tmp = V::gt(zero_, b);
+        V::store(KSW_BLK(y, t), V::drop(tmp, b), n);
+        d = V::or_(d, V::drop(tmp, flag16_)); // d = 0 > b? 0 : 0x10
+        V::store(KSW_BLK(pr, t), d, n);
+      }
+    }
+    if (!approx_max) { // find the exact max with a 32-bit score array
+      int32_t max_H, max_t;
+      // compute H[], max_H and max_t
+      if (r > 0) {
+        max_H = H[en0] =
+            en0 > 0 ? H[en0 - 1] + u8[en0] - qe
+                    : H[en0] + v8[en0] - qe; // special casing the last element
+        max_t = en0;
+        ksw_row_max<V>(H, v8, -qe, st0, en0, max_H, max_t);
+      } else
+        H[0] = v8[0] - qe - qe, max_H = H[0],
+        max_t = 0; // special casing r==0
+      // update ez
+      if (en0 == tlen - 1 && H[en0] > ez->mte)
+        ez->mte = H[en0], ez->mte_q = r - en;
+      if (r - st0 == qlen - 1 && H[st0] > ez->mqe)
+        ez->mqe = H[st0], ez->mqe_t = st0;
+      if (ksw_apply_zdrop(ez, 1, max_H, r, max_t, zdrop, e))
+        break;
+      if (r == qlen + tlen - 2 && en0 == tlen - 1)
+        ez->score = H[tlen - 1];
+    } else { // find approximate max; Z-drop might be inaccurate, too.
+      if (r > 0) {
+        if (last_H0_t >= st0 && last_H0_t <= en0 && last_H0_t + 1 >= st0 &&
+            last_H0_t + 1 <= en0) {
+          int32_t d0 = v8[last_H0_t] - qe;
+          int32_t d1 = u8[last_H0_t + 1] - qe;
+          if (d0 > d1)
+            H0 += d0;
+          else
+            H0 += d1, ++last_H0_t;
+        } else if (last_H0_t >= st0 && last_H0_t <= en0) {
+          H0 += v8[last_H0_t] - qe;
+        } else {
+          ++last_H0_t, H0 += u8[last_H0_t] - qe;
+        }
+        if ((flag & KSW_EZ_APPROX_DROP) &&
+            ksw_apply_zdrop(ez, 1, H0, r, last_H0_t, zdrop, e))
+          break;
+      } else
+        H0 = v8[0] - qe - qe, last_H0_t = 0;
+      if (r == qlen + tlen - 2 && en0 == tlen - 1)
+        ez->score = H0;
+    }
+    last_st = st, last_en = en;
+  }
+  kfree(km, mem);
+  if (!approx_max)
+    kfree(km, H);
+  if (with_cigar) { // backtrack
+    int rev_cigar = !!(flag & KSW_EZ_REV_CIGAR);
+    if (!ez->zdropped && !(flag & KSW_EZ_EXTZ_ONLY)) {
+      ksw_backtrack(km, 1, rev_cigar, 0, p, off, off_end, n_col_ * 16,
+                    tlen - 1, qlen - 1, &ez->m_cigar, &ez->n_cigar,
+                    &ez->cigar);
+    } else if (!ez->zdropped && (flag & KSW_EZ_EXTZ_ONLY) &&
+               ez->mqe + end_bonus > (int)ez->max) {
+      ez->reach_end = 1;
+      ksw_backtrack(km, 1, rev_cigar, 0, p, off, off_end, n_col_ * 16,
+                    ez->mqe_t, qlen - 1, &ez->m_cigar, &ez->n_cigar,
+                    &ez->cigar);
+    } else if (ez->max_t >= 0 && ez->max_q >= 0) {
+      ksw_backtrack(km, 1, rev_cigar, 0, p, off, off_end, n_col_ * 16,
+                    ez->max_t, ez->max_q, &ez->m_cigar, &ez->n_cigar,
+                    &ez->cigar);
+    }
+    kfree(km, mem2);
+    kfree(km, off);
+  }
+}
+
+template <class V>
+void extd2(void *km, int qlen, const uint8_t *query, int tlen,
+           const uint8_t *target, int8_t m, const int8_t *mat, int8_t q,
+           int8_t e, int8_t q2, int8_t e2, int w, int zdrop, int end_bonus,
+           int flag, ksw_extz_t *ez) {
+  using Vec = typename V::Vec;
+  using Cmp = typename V::Cmp;
+  int r, t, qe = q + e, n_col_, *off = 0, *off_end = 0, tlen_, qlen_, last_st,
+            last_en, wl, wr, max_sc, min_sc, long_thres, long_diff;
+  int with_cigar = !(flag & KSW_EZ_SCORE_ONLY),
+      approx_max = !!(flag & KSW_EZ_APPROX_MAX);
+  int32_t *H = 0, H0 = 0, last_H0_t = 0;
+  uint8_t *qr, *sf, *mem, *mem2 = 0;
+  uint8_t *u, *v, *x, *y, *x2, *y2, *s, *p = 0;
+
+  ksw_reset_extz(ez);
+  if (m <= 1 || qlen <= 0 || tlen <= 0)
+    return;
+
+  if (q2 + e2 < q + e)
+    t = q, q = q2, q2 = t, t = e, e = e2,
+    e2 = t; // make sure q+e no larger than q2+e2
+
+  const Vec zero_ = V::set(0), q_ = V::set(q), q2_ = V::set(q2),
+            qe_ = V::set(q + e), qe2_ = V::set(q2 + e2),
+            sc_mch_ = V::set(mat[0]), sc_mis_ = V::set(mat[1]),
+            sc_N_ = V::set(mat[m * m - 1] == 0 ? -e2 : mat[m * m - 1]),
+            m1_ = V::set(m - 1), flag1_ = V::set(1), flag2_ = V::set(2),
+            flag3_ = V::set(3), flag4_ = V::set(4), flag8_ = V::set(0x08),
+            flag16_ = V::set(0x10), flag32_ = V::set(0x20),
+            flag64_ = V::set(0x40);
+
+  if (w < 0)
+    w = tlen > qlen ? tlen : qlen;
+  wl = wr = w;
+  tlen_ = (tlen + 15) / 16;
+  n_col_ = qlen < tlen ? qlen : tlen;
+  n_col_ = ((n_col_ < w + 1 ? n_col_ : w + 1) + 15) / 16 + 1;
+  qlen_ = (qlen + 15) / 16;
+  for (t = 1, max_sc = mat[0], min_sc = mat[1]; t < m * m; ++t) {
+    max_sc = max_sc > mat[t] ? max_sc : mat[t];
+    min_sc = min_sc < mat[t] ? min_sc : mat[t];
+  }
+  if (-min_sc > 2 * (q + e))
+    return; // otherwise, we won't see any mismatches
+
+  long_thres = e != e2 ? (q2 - q) / (e - e2) - 1 : 0;
+  if (q2 + e2 + long_thres * e2 > q + e + long_thres * e)
+    ++long_thres;
+  long_diff = long_thres * (e - e2) - (q2 - q) - e2;
+
+  // vectors may read up to BLOCKS - 1 blocks past the arrays
+  mem = (uint8_t *)kcalloc(km, tlen_ * 8 + qlen_ + V::BLOCKS, 16);
+  u = (uint8_t *)(((size_t)mem + 15) >> 4 << 4); // 16-byte aligned
+  v = KSW_BLK(u, tlen_), x = KSW_BLK(v, tlen_), y = KSW_BLK(x, tlen_),
+  x2 = KSW_BLK(y, tlen_), y2 = KSW_BLK(x2, tlen_);
+  s = KSW_BLK(y2, tlen_), sf = KSW_BLK(s, tlen_), qr = sf + tlen_ * 16;
+  memset(u, -q - e, tlen_ * 16);
+  memset(v, -q - e, tlen_ * 16);
+  memset(x, -q - e, tlen_ * 16);
+  memset(y, -q - e, tlen_ * 16);
+  memset(x2, -q2 - e2, tlen_ * 16);
+  memset(y2, -q2 - e2, tlen_ * 16);
+  if (!approx_max) {
+    H = (int32_t *)kmalloc(km, tlen_ * 16 * 4);
+    for (t = 0; t < tlen_ * 16; ++t)
+      H[t] = KSW_NEG_INF;
+  }
+  if (with_cigar) {
+    mem2 =
+        (uint8_t *)kmalloc(km, ((size_t)(qlen + tlen - 1) * n_col_ + 1) * 16);
+    p = (uint8_t *)(((size_t)mem2 + 15) >> 4 << 4);
+    off = (int *)kmalloc(km, (qlen + tlen - 1) * sizeof(int) * 2);
+    off_end = off + qlen + tlen - 1;
+  }
+
+  for (t = 0; t < qlen; ++t)
+    qr[t] = query[qlen - 1 - t];
+  memcpy(sf, target, tlen);
+
+  for (r = 0, last_st = last_en = -1; r < qlen + tlen - 1; ++r) {
+    int st = 0, en = tlen - 1, st0, en0, st_, en_;
+    int8_t x1, x21, v1;
+    uint8_t *qrr = qr + (qlen - 1 - r);
+    int8_t *u8 = (int8_t *)u, *v8 = (int8_t *)v, *x8 = (int8_t *)x,
+           *x28 = (int8_t *)x2;
+    Vec x1_, x21_, v1_;
+    // find the boundaries
+    if (st < r - qlen + 1)
+      st = r - qlen + 1;
+    if (en > r)
+      en = r;
+    if (st < ((r - wr + 1) >> 1))
+      st = (r - wr + 1) >> 1; // take the ceil
+    if (en > (r + wl) >> 1)
+      en = (r + wl) >> 1; // take the floor
+    if (st > en) {
+      ez->zdropped = 1;
+      break;
+    }
+    st0 = st, en0 = en;
+    st = st / 16 * 16, en = (en + 16) / 16 * 16 - 1;
+    // set boundary conditions
+    if (st > 0) {
+      if (st - 1 >= last_st && st - 1 <= last_en) {
+        x1 = x8[st - 1], x21 = x28[st - 1],
+        v1 = v8[st - 1]; // (r-1,s-1) calculated in the last round
+      } else {
+        x1 = -q - e, x21 = -q2 - e2;
+        v1 = -q - e;
+      }
+    } else {
+      x1 = -q - e, x21 = -q2 - e2;
+      v1 = r == 0 ? -q - e
+                  : r < long_thres ? -e : r == long_thres ? long_diff : -e2;
+    }
+    if (en >= r) {
+      ((int8_t *)y)[r] = -q - e, ((int8_t *)y2)[r] = -q2 - e2;
+      u8[r] = r == 0 ? -q - e
+                     : r < long_thres ? -e : r == long_thres ? long_diff : -e2;
+    }
+    // loop fission: set scores first
+    if (!(flag & KSW_EZ_GENERIC_SC))
+      ksw_set_scores<V>(s, sf, qrr, st0, en0, sc_mch_, sc_mis_, sc_N_, m1_);
+    else
+      for (t = st0; t <= en0; ++t)
+        s[t] = mat[sf[t] * m + qrr[t]];
+    // core loop; x1_, x21_ and v1_ hold the last cells of the previous vector
+    x1_ = V::set(x1);
+    x21_ = V::set(x21);
+    v1_ = V::set(v1);
+    st_ = st / 16, en_ = en / 16;
+    assert(en_ - st_ + 1 <= n_col_);
+    uint8_t *pr = with_cigar ? KSW_BLK(p, (size_t)r * n_col_ - st_) : nullptr;
+    if (with_cigar)
+      off[r] = st, off_end[r] = en;
+    for (t = st_; t <= en_; t += V::BLOCKS) {
+      const int n = en_ - t + 1; // blocks left
+      Vec z, a, b, a2, b2, xt1, x2t1, vt1, ut, tmp, d;
+      z = V::load(KSW_BLK(s, t));
+      tmp = V::load(KSW_BLK(x, t));
+      xt1 = V::shift_in(tmp, x1_); // xt1 <- x[r-1][t-1..t+W-2]
+      x1_ = tmp;
+      tmp = V::load(KSW_BLK(v, t));
+      vt1 = V::shift_in(tmp, v1_); // vt1 <- v[r-1][t-1..t+W-2]
+      v1_ = tmp;
+      a = V::add(xt1, vt1);
+      ut = V::load(KSW_BLK(u, t));
+      b = V::add(V::load(KSW_BLK(y, t)), ut);
+      tmp = V::load(KSW_BLK(x2, t));
+      x2t1 = V::shift_in(tmp, x21_);
+      x21_ = tmp;
+      a2 = V::add(x2t1, vt1);
+      b2 = V::add(V::load(KSW_BLK(y2, t)), ut);
+      if (!with_cigar) { // score only
+        z = V::max(z, a);
+        z = V::max(z, b);
+        z = V::max(z, a2);
+        z = V::max(z, b2);
+      } else if (!(flag & KSW_EZ_RIGHT)) { // gap left-alignment
+        d = V::keep(V::gt(a, z), flag1_);  // d = a  > z? 1 : 0
+        z = V::max(z, a);
+        d = V::blend(V::gt(b, z), d, flag2_); // d = b  > z? 2 : d
+        z = V::max(z, b);
+        d = V::blend(V::gt(a2, z), d, flag3_); // d = a2 > z? 3 : d
+        z = V::max(z, a2);
+        d = V::blend(V::gt(b2, z), d, flag4_); // d = b2 > z? 4 : d
+        z = V::max(z, b2);
+      } else {                                // gap right-alignment
+        d = V::drop(V::gt(z, a), flag1_);     // d = z > a?  0 : 1
+        z = V::max(z, a);
+        d = V::blend(V::gt(z, b), flag2_, d); // d = z > b?  d : 2
+        z = V::max(z, b);
+        d = V::blend(V::gt(z, a2), flag3_, d); // d = z > a2? d : 3
+        z = V::max(z, a2);
+        d = V::blend(V::gt(z, b2), flag4_, d); // d = z > b2? d : 4
+        z = V::max(z, b2);
+      }
+      z = V::min(z, sc_mch_);
+      V::store(KSW_BLK(u, t), V::sub(z, vt1), n); // u[r][t..] <- z - v[r-1][t-1..]
+      V::store(KSW_BLK(v, t), V::sub(z, ut), n);  // v[r][t..] <- z - u[r-1][t..]
+      tmp = V::sub(z, q_);
+      a = V::sub(a, tmp);
+      b = V::sub(b, tmp);
+      tmp = V::sub(z, q2_);
+      a2 = V::sub(a2, tmp);
+      b2 = V::sub(b2, tmp);
+      if (!with_cigar) {
+        V::store(KSW_BLK(x, t), V::sub(V::max(a, zero_), qe_), n);
+        V::store(KSW_BLK(y, t), V::sub(V::max(b, zero_), qe_), n);
+        V::store(KSW_BLK(x2, t), V::sub(V::max(a2, zero_), qe2_), n);
+        V::store(KSW_BLK(y2, t), V::sub(V::max(b2, zero_), qe2_), n);
+      } else if (!(flag & KSW_EZ_RIGHT)) {
+        Cmp c = V::gt(a, zero_);
+        V::store(KSW_BLK(x, t), V::sub(V::keep(c, a), qe_), n);
+        d = V::or_(d, V::keep(c, flag8_)); // d = a > 0? 1<<3 : 0
+        c = V::gt(b, zero_);
+        V::store(KSW_BLK(y, t), V::sub(V::keep(c, b), qe_), n);
+        d = V::or_(d, V::keep(c, flag16_)); // d = b > 0? 1<<4 : 0
+        c = V::gt(a2, zero_);
+        V::store(KSW_BLK(x2, t), V::sub(V::keep(c, a2), qe2_), n);
+        d = V::or_(d, V::keep(c, flag32_)); // d = a2 > 0? 1<<5 : 0
+        c = V::gt(b2, zero_);
+        V::store(KSW_BLK(y2, t), V::sub(V::keep(c, b2), qe2_), n);
+        d = V::or_(d, V::keep(c, flag64_)); // d = b2 > 0? 1<<6 : 0
+        V::store(KSW_BLK(pr, t), d, n);
+      } else {
+        Cmp c = V::gt(zero_, a);
+        V::store(KSW_BLK(x, t), V::sub(V::drop(c, a), qe_), n);
+        d = V::or_(d, V::drop(c, flag8_)); // d = a > 0? 1<<3 : 0
+        c = V::gt(zero_, b);
+        V::store(KSW_BLK(y, t), V::sub(V::drop(c, b), qe_), n);
+        d = V::or_(d, V::drop(c, flag16_)); // d = b > 0? 1<<4 : 0
+        c = V::gt(zero_, a2);
+        V::store(KSW_BLK(x2, t), V::sub(V::drop(c, a2), qe2_), n);
+        d = V::or_(d, V::drop(c, flag32_)); // d = a2 > 0? 1<<5 : 0
+        c = V::gt(zero_, b2);
+        V::store(KSW_BLK(y2, t), V::sub(V::drop(c, b2), qe2_), n);
+        d = V::or_(d, V::drop(c, flag64_)); // d = b2 > 0? 1<<6 : 0
+        V::store(KSW_BLK(pr, t), d, n);
+      }
+    }
+    if (!approx_max) { // find the exact max with a 32-bit score array
+      int32_t max_H, max_t;
+      // compute H[], max_H and max_t
+      if (r > 0) {
+        max_H = H[en0] =
+            en0 > 0 ? H[en0 - 1] + u8[en0]
+                    : H[en0] + v8[en0]; // special casing the last element
+        max_t = en0;
+        ksw_row_max<V>(H, v8, 0, st0, en0, max_H, max_t);
+      } else
+        H[0] = v8[0] - qe, max_H = H[0],
+        max_t = 0; // special casing r==0
+      // update ez
+      if (en0 == tlen - 1 && H[en0] > ez->mte)
+        ez->mte = H[en0], ez->mte_q = r - en;
+      if (r - st0 == qlen - 1 && H[st0] > ez->mqe)
+        ez->mqe = H[st0], ez->mqe_t = st0;
+      if (ksw_apply_zdrop(ez, 1, max_H, r, max_t, zdrop, e2))
+        break;
+      if (r == qlen + tlen - 2 && en0 == tlen - 1)
+        ez->score = H[tlen - 1];
+    } else { // find approximate max; Z-drop might be inaccurate, too.
+      if (r > 0) {
+        if (last_H0_t >= st0 && last_H0_t <= en0 && last_H0_t + 1 >= st0 &&
+            last_H0_t + 1 <= en0) {
+          int32_t d0 = v8[last_H0_t];
+          int32_t d1 = u8[last_H0_t + 1];
+          if (d0 > d1)
+            H0 += d0;
+          else
+            H0 += d1, ++last_H0_t;
+        } else if (last_H0_t >= st0 && last_H0_t <= en0) {
+          H0 += v8[last_H0_t];
+        } else {
+          ++last_H0_t, H0 += u8[last_H0_t];
+        }
+      } else
+        H0 = v8[0] - qe, last_H0_t = 0;
+      if ((flag & KSW_EZ_APPROX_DROP) &&
+          ksw_apply_zdrop(ez, 1, H0, r, last_H0_t, zdrop, e2))
+        break;
+      if (r == qlen + tlen - 2 && en0 == tlen - 1)
+        ez->score = H0;
+    }
+    last_st = st, last_en = en;
+  }
+  kfree(km, mem);
+  if (!approx_max)
+    kfree(km, H);
+  if (with_cigar) { // backtrack
+    int rev_cigar = !!(flag & KSW_EZ_REV_CIGAR);
+    if (!ez->zdropped && !(flag & KSW_EZ_EXTZ_ONLY)) {
+      ksw_backtrack(km, 1, rev_cigar, 0, p, off, off_end, n_col_ * 16,
+                    tlen - 1, qlen - 1, &ez->m_cigar, &ez->n_cigar,
+                    &ez->cigar);
+    } else if (!ez->zdropped && (flag & KSW_EZ_EXTZ_ONLY) &&
+               ez->mqe + end_bonus > (int)ez->max) {
+      ez->reach_end = 1;
+      ksw_backtrack(km, 1, rev_cigar, 0, p, off, off_end, n_col_ * 16,
+                    ez->mqe_t, qlen - 1, &ez->m_cigar, &ez->n_cigar,
+                    &ez->cigar);
+    } else if (ez->max_t >= 0 && ez->max_q >= 0) {
+      ksw_backtrack(km, 1, rev_cigar, 0, p, off, off_end, n_col_ * 16,
+                    ez->max_t, ez->max_q, &ez->m_cigar, &ez->n_cigar,
+                    &ez->cigar);
+    }
+    kfree(km, mem2);
+    kfree(km, off);
+  }
+}
+
+template <class V>
+void exts2(void *km, int qlen, const uint8_t *query, int tlen,
+           const uint8_t *target, int8_t m, const int8_t *mat, int8_t q,
+           int8_t e, int8_t q2, int8_t noncan, int zdrop, int flag,
+           ksw_extz_t *ez) {
+  using Vec = typename V::Vec;
+  using Cmp = typename V::Cmp;
+  int r, t, qe = q + e, n_col_, *off = 0, *off_end = 0, tlen_, qlen_, last_st,
+            last_en, max_sc, min_sc, long_thres, long_diff;
+  int with_cigar = !(flag & KSW_EZ_SCORE_ONLY),
+      approx_max = !!(flag & KSW_EZ_APPROX_MAX);
+  int32_t *H = 0, H0 = 0, last_H0_t = 0;
+  uint8_t *qr, *sf, *mem, *mem2 = 0;
+  uint8_t *u, *v, *x, *y, *x2, *s, *p = 0, *donor, *acceptor;
+
+  ksw_reset_extz(ez);
+  if (m <= 1 || qlen <= 0 || tlen <= 0 || q2 <= q + e)
+    return;
+
+  const Vec zero_ = V::set(0), q_ = V::set(q), q2_ = V::set(q2),
+            qe_ = V::set(q + e), sc_mch_ = V::set(mat[0]),
+            sc_mis_ = V::set(mat[1]),
+            sc_N_ = V::set(mat[m * m - 1] == 0 ? -e : mat[m * m - 1]),
+            m1_ = V::set(m - 1), flag1_ = V::set(1), flag2_ = V::set(2),
+            flag3_ = V::set(3), flag8_ = V::set(0x08), flag16_ = V::set(0x10),
+            flag32_ = V::set(0x20);
+
+  tlen_ = (tlen + 15) / 16;
+  n_col_ = ((qlen < tlen ? qlen : tlen) + 15) / 16 + 1;
+  qlen_ = (qlen + 15) / 16;
+  for (t = 1, max_sc = mat[0], min_sc = mat[1]; t < m * m; ++t) {
+    max_sc = max_sc > mat[t] ? max_sc : mat[t];
+    min_sc = min_sc < mat[t] ? min_sc : mat[t];
+  }
+  if (-min_sc > 2 * (q + e))
+    return; // otherwise, we won't see any mismatches
+
+  long_thres = (q2 - q) / e - 1;
+  if (q2 > q + e + long_thres * e)
+    ++long_thres;
+  long_diff = long_thres * e - (q2 - q);
+
+  // vectors may read up to BLOCKS - 1 blocks past the arrays
+  mem = (uint8_t *)kcalloc(km, tlen_ * 9 + qlen_ + V::BLOCKS, 16);
+  u = (uint8_t *)(((size_t)mem + 15) >> 4 << 4); // 16-byte aligned
+  v = KSW_BLK(u, tlen_), x = KSW_BLK(v, tlen_), y = KSW_BLK(x, tlen_),
+  x2 = KSW_BLK(y, tlen_);
+  donor = KSW_BLK(x2, tlen_), acceptor = KSW_BLK(donor, tlen_);
+  s = KSW_BLK(acceptor, tlen_), sf = KSW_BLK(s, tlen_), qr = sf + tlen_ * 16;
+  memset(u, -q - e,
+         tlen_ * 16 *
+             4); // this set u, v, x, y (because they are in the same array)
+  memset(x2, -q2, tlen_ * 16);
+  if (!approx_max) {
+    H = (int32_t *)kmalloc(km, tlen_ * 16 * 4);
+    for (t = 0; t < tlen_ * 16; ++t)
+      H[t] = KSW_NEG_INF;
+  }
+  if (with_cigar) {
+    mem2 =
+        (uint8_t *)kmalloc(km, ((size_t)(qlen + tlen - 1) * n_col_ + 1) * 16);
+    p = (uint8_t *)(((size_t)mem2 + 15) >> 4 << 4);
+    off = (int *)kmalloc(km, (qlen + tlen - 1) * sizeof(int) * 2);
+    off_end = off + qlen + tlen - 1;
+  }
+
+  for (t = 0; t < qlen; ++t)
+    qr[t] = query[qlen - 1 - t];
+  memcpy(sf, target, tlen);
+
+  // set the donor and acceptor arrays. TODO: this assumes 0/1/2/3 encoding!
+  if (flag & (KSW_EZ_SPLICE_FOR | KSW_EZ_SPLICE_REV)) {
+    int semi_cost = flag & KSW_EZ_SPLICE_FLANK
+                        ? -noncan / 2
+                        : 0; // GTr or yAG is worth 0.5 bit; see PMID:18688272
+    memset(donor, -noncan, tlen_ * 16);
+    for (t = 0; t < tlen - 4; ++t) {
+      int can_type =
+          0; // type of canonical site: 0=none, 1=GT/AG only, 2=GTr/yAG
+      if ((flag & KSW_EZ_SPLICE_FOR) && target[t + 1] == 2 &&
+          target[t + 2] == 3)
+        can_type = 1; // GTr...
+      if ((flag & KSW_EZ_SPLICE_REV) && target[t + 1] == 1 &&
+          target[t + 2] == 3)
+        can_type = 1; // CTr...
+      if (can_type && (target[t + 3] == 0 || target[t + 3] == 2))
+        can_type = 2;
+      if (can_type)
+        ((int8_t *)donor)[t] = can_type == 2 ? 0 : semi_cost;
+    }
+    memset(acceptor, -noncan, tlen_ * 16);
+    for (t = 2; t < tlen; ++t) {
+      int can_type = 0;
+      if ((flag & KSW_EZ_SPLICE_FOR) && target[t - 1] == 0 && target[t] == 2)
+        can_type = 1; // ...yAG
+      if ((flag & KSW_EZ_SPLICE_REV) && target[t - 1] == 0 && target[t] == 1)
+        can_type = 1; // ...yAC
+      if (can_type && (target[t - 2] == 1 || target[t - 2] == 3))
+        can_type = 2;
+      if (can_type)
+        ((int8_t *)acceptor)[t] = can_type == 2 ? 0 : semi_cost;
+    }
+  }
+
+  for (r = 0, last_st = last_en = -1; r < qlen + tlen - 1; ++r) {
+    int st = 0, en = tlen - 1, st0, en0, st_, en_;
+    int8_t x1, x21, v1, *u8 = (int8_t *)u, *v8 = (int8_t *)v;
+    uint8_t *qrr = qr + (qlen - 1 - r);
+    Vec x1_, x21_, v1_;
+    // find the boundaries
+    if (st < r - qlen + 1)
+      st = r - qlen + 1;
+    if (en > r)
+      en = r;
+    st0 = st, en0 = en;
+    st = st / 16 * 16, en = (en + 16) / 16 * 16 - 1;
+    // set boundary conditions
+    if (st > 0) {
+      if (st - 1 >= last_st && st - 1 <= last_en)
+        x1 = ((int8_t *)x)[st - 1], x21 = ((int8_t *)x2)[st - 1],
+        v1 = v8[st - 1]; // (r-1,s-1) calculated in the last round
+      else
+        x1 = -q - e, x21 = -q2, v1 = -q - e;
+    } else {
+      x1 = -q - e, x21 = -q2;
+      v1 = r == 0 ? -q - e
+                  : r < long_thres ? -e : r == long_thres ? long_diff : 0;
+    }
+    if (en >= r) {
+      ((int8_t *)y)[r] = -q - e;
+      u8[r] = r == 0 ? -q - e
+                     : r < long_thres ? -e : r == long_thres ? long_diff : 0;
+    }
+    // loop fission: set scores first
+    if (!(flag & KSW_EZ_GENERIC_SC))
+      ksw_set_scores<V>(s, sf, qrr, st0, en0, sc_mch_, sc_mis_, sc_N_, m1_);
+    else
+      for (t = st0; t <= en0; ++t)
+        s[t] = mat[sf[t] * m + qrr[t]];
+    // core loop; x1_, x21_ and v1_ hold the last cells of the previous vector
+    x1_ = V::set(x1);
+    x21_ = V::set(x21);
+    v1_ = V::set(v1);
+    st_ = st / 16, en_ = en / 16;
+    assert(en_ - st_ + 1 <= n_col_);
+    uint8_t *pr = with_cigar ? KSW_BLK(p, (size_t)r * n_col_ - st_) : nullptr;
+    if (with_cigar)
+      off[r] = st, off_end[r] = en;
+    for (t = st_; t <= en_; t += V::BLOCKS) {
+      const int n = en_ - t + 1; // blocks left
+      Vec z, a, b, a2, a2a, xt1, x2t1, vt1, ut, tmp, dn, d;
+      z = V::load(KSW_BLK(s, t));
+      tmp = V::load(KSW_BLK(x, t));
+      xt1 = V::shift_in(tmp, x1_); // xt1 <- x[r-1][t-1..t+W-2]
+      x1_ = tmp;
+      tmp = V::load(KSW_BLK(v, t));
+      vt1 = V::shift_in(tmp, v1_); // vt1 <- v[r-1][t-1..t+W-2]
+      v1_ = tmp;
+      a = V::add(xt1, vt1);
+      ut = V::load(KSW_BLK(u, t));
+      b = V::add(V::load(KSW_BLK(y, t)), ut);
+      tmp = V::load(KSW_BLK(x2, t));
+      x2t1 = V::shift_in(tmp, x21_);
+      x21_ = tmp;
+      a2 = V::add(x2t1, vt1);
+      a2a = V::add(a2, V::load(KSW_BLK(acceptor, t)));
+      if (!with_cigar) { // score only
+        z = V::max(z, a);
+        z = V::max(z, b);
+        z = V::max(z, a2a);
+      } else if (!(flag & KSW_EZ_RIGHT)) { // gap left-alignment
+        d = V::keep(V::gt(a, z), flag1_);  // d = a  > z? 1 : 0
+        z = V::max(z, a);
+        d = V::blend(V::gt(b, z), d, flag2_); // d = b  > z? 2 : d
+        z = V::max(z, b);
+        d = V::blend(V::gt(a2a, z), d, flag3_); // d = a2 > z? 3 : d
+        z = V::max(z, a2a);
+      } else {                                // gap right-alignment
+        d = V::drop(V::gt(z, a), flag1_);     // d = z > a?  0 : 1
+        z = V::max(z, a);
+        d = V::blend(V::gt(z, b), flag2_, d); // d = z > b?  d : 2
+        z = V::max(z, b);
+        d = V::blend(V::gt(z, a2a), flag3_, d); // d = z > a2? d : 3
+        z = V::max(z, a2a);
+      }
+      V::store(KSW_BLK(u, t), V::sub(z, vt1), n); // u[r][t..] <- z - v[r-1][t-1..]
+      V::store(KSW_BLK(v, t), V::sub(z, ut), n);  // v[r][t..] <- z - u[r-1][t..]
+      tmp = V::sub(z, q_);
+      a = V::sub(a, tmp);
+      b = V::sub(b, tmp);
+      a2 = V::sub(a2, V::sub(z, q2_));
+      dn = V::load(KSW_BLK(donor, t));
+      if (!with_cigar) {
+        V::store(KSW_BLK(x, t), V::sub(V::max(a, zero_), qe_), n);
+        V::store(KSW_BLK(y, t), V::sub(V::max(b, zero_), qe_), n);
+        V::store(KSW_BLK(x2, t), V::sub(V::max(a2, dn), q2_), n);
+      } else if (!(flag & KSW_EZ_RIGHT)) {
+        Cmp c = V::gt(a, zero_);
+        V::store(KSW_BLK(x, t), V::sub(V::keep(c, a), qe_), n);
+        d = V::or_(d, V::keep(c, flag8_)); // d = a > 0? 1<<3 : 0
+        c = V::gt(b, zero_);
+        V::store(KSW_BLK(y, t), V::sub(V::keep(c, b), qe_), n);
+        d = V::or_(d, V::keep(c, flag16_)); // d = b > 0? 1<<4 : 0
+        c = V::gt(a2, dn);
+        V::store(KSW_BLK(x2, t), V::sub(V::max(a2, dn), q2_), n);
+        d = V::or_(d, V::keep(c, flag32_)); // d = a2 > donor? 1<<5 : 0
+        V::store(KSW_BLK(pr, t), d, n);
+      } else {
+        Cmp c = V::gt(zero_, a);
+        V::store(KSW_BLK(x, t), V::sub(V::drop(c, a), qe_), n);
+        d = V::or_(d, V::drop(c, flag8_)); // d = a > 0? 1<<3 : 0
+        c = V::gt(zero_, b);
+        V::store(KSW_BLK(y, t), V::sub(V::drop(c, b), qe_), n);
+        d = V::or_(d, V::drop(c, flag16_)); // d = b > 0? 1<<4 : 0
+        c = V::gt(dn, a2);
+        V::store(KSW_BLK(x2, t), V::sub(V::max(dn, a2), q2_), n);
+        d = V::or_(d, V::drop(c, flag32_)); // d = donor > a2? 0 : 1<<5
+        V::store(KSW_BLK(pr, t), d, n);
+      }
+    }
+    if (!approx_max) { // find the exact max with a 32-bit score array
+      int32_t max_H, max_t;
+      // compute H[], max_H and max_t
+      if (r > 0) {
+        max_H = H[en0] =
+            en0 > 0 ? H[en0 - 1] + u8[en0]
+                    : H[en0] + v8[en0]; // special casing the last element
+        max_t = en0;
+        ksw_row_max<V>(H, v8, 0, st0, en0, max_H, max_t);
+      } else
+        H[0] = v8[0] - qe, max_H = H[0],
+        max_t = 0; // special casing r==0
+      // update ez
+      if (en0 == tlen - 1 && H[en0] > ez->mte)
+        ez->mte = H[en0], ez->mte_q = r - en;
+      if (r - st0 == qlen - 1 && H[st0] > ez->mqe)
+        ez->mqe = H[st0], ez->mqe_t = st0;
+      if (ksw_apply_zdrop(ez, 1, max_H, r, max_t, zdrop, 0))
+        break;
+      if (r == qlen + tlen - 2 && en0 == tlen - 1)
+        ez->score = H[tlen - 1];
+    } else { // find approximate max; Z-drop might be inaccurate, too.
+      if (r > 0) {
+        if (last_H0_t >= st0 && last_H0_t <= en0 && last_H0_t + 1 >= st0 &&
+            last_H0_t + 1 <= en0) {
+          int32_t d0 = v8[last_H0_t];
+          int32_t d1 = u8[last_H0_t + 1];
+          if (d0 > d1)
+            H0 += d0;
+          else
+            H0 += d1, ++last_H0_t;
+        } else if (last_H0_t >= st0 && last_H0_t <= en0) {
+          H0 += v8[last_H0_t];
+        } else {
+          ++last_H0_t, H0 += u8[last_H0_t];
+        }
+      } else
+        H0 = v8[0] - qe, last_H0_t = 0;
+      if ((flag & KSW_EZ_APPROX_DROP) &&
+          ksw_apply_zdrop(ez, 1, H0, r, last_H0_t, zdrop, 0))
+        break;
+      if (r == qlen + tlen - 2 && en0 == tlen - 1)
+        ez->score = H0;
+    }
+    last_st = st, last_en = en;
+  }
+  kfree(km, mem);
+  if (!approx_max)
+    kfree(km, H);
+  if (with_cigar) { // backtrack
+    int rev_cigar = !!(flag & KSW_EZ_REV_CIGAR);
+    if (!ez->zdropped && !(flag & KSW_EZ_EXTZ_ONLY))
+      ksw_backtrack(km, 1, rev_cigar, long_thres, p, off, off_end, n_col_ * 16,
+                    tlen - 1, qlen - 1, &ez->m_cigar, &ez->n_cigar,
+                    &ez->cigar);
+    else if (ez->max_t >= 0 && ez->max_q >= 0)
+      ksw_backtrack(km, 1, rev_cigar, long_thres, p, off, off_end, n_col_ * 16,
+                    ez->max_t, ez->max_q, &ez->m_cigar, &ez->n_cigar,
+                    &ez->cigar);
+    kfree(km, mem2);
+    kfree(km, off);
+  }
+}
+
+template <class V>
+int gg2(void *km, int qlen, const uint8_t *query, int tlen,
+        const uint8_t *target, int8_t m, const int8_t *mat, int8_t q, int8_t e,
+        int w, int *m_cigar_, int *n_cigar_, uint32_t **cigar_) {
+  using Vec = typename V::Vec;
+  using Cmp = typename V::Cmp;
+  int r, t, n_col, n_col_, *off, tlen_, last_st, last_en, H0 = 0, last_H0_t = 0;
+  uint8_t *qr, *mem, *mem2;
+  uint8_t *u, *v, *x, *y, *s, *p;
+  const Vec zero_ = V::set(0), q_ = V::set(q), qe2_ = V::set((q + e) * 2),
+            flag1_ = V::set(1), flag2_ = V::set(2), flag8_ = V::set(0x08),
+            flag16_ = V::set(0x10);
+
+  if (w < 0)
+    w = tlen > qlen ? tlen : qlen;
+  n_col =
+      w + 1 < tlen ? w + 1 : tlen; // number of columns in the backtrack matrix
+  tlen_ = (tlen + 15) / 16;
+  n_col_ = (n_col + 15) / 16 + 1;
+  n_col = n_col_ * 16;
+
+  // vectors may read up to BLOCKS - 1 blocks past the arrays
+  mem = (uint8_t *)kcalloc(km, tlen_ * 5 + V::BLOCKS, 16);
+  u = (uint8_t *)(((size_t)mem + 15) >> 4 << 4); // 16-byte aligned
+  v = KSW_BLK(u, tlen_), x = KSW_BLK(v, tlen_), y = KSW_BLK(x, tlen_),
+  s = KSW_BLK(y, tlen_);
+  qr = (uint8_t *)kcalloc(km, qlen, 1);
+  mem2 = (uint8_t *)kmalloc(km, ((size_t)(qlen + tlen - 1) * n_col_ + 1) * 16);
+  p = (uint8_t *)(((size_t)mem2 + 15) >> 4 << 4);
+  off = (int *)kmalloc(km, (qlen + tlen - 1) * sizeof(int));
+
+  for (t = 0; t < qlen; ++t)
+    qr[t] = query[qlen - 1 - t];
+
+  for (r = 0, last_st = last_en = -1; r < qlen + tlen - 1; ++r) {
+    int st = 0, en = tlen - 1, st0, en0, st_, en_;
+    int8_t x1, v1;
+    Vec x1_, v1_;
+    uint8_t *pr;
+    // find the boundaries
+    if (st < r - qlen + 1)
+      st = r - qlen + 1;
+    if (en > r)
+      en = r;
+    if (st < ((r - w + 1) >> 1))
+      st = (r - w + 1) >> 1; // take the ceil
+    if (en > (r + w) >> 1)
+      en = (r + w) >> 1; // take the floor
+    st0 = st, en0 = en;
+    st = st / 16 * 16, en = (en + 16) / 16 * 16 - 1;
+    off[r] = st;
+    // set boundary conditions
+    if (st > 0) {
+      if (st - 1 >= last_st && st - 1 <= last_en)
+        x1 = x[st - 1], v1 = v[st - 1]; // (r-1,s-1) calculated in the last
+                                        // round
+      else
+        x1 = v1 = 0; // not calculated; set to zeros
+    } else
+      x1 = 0, v1 = r ? q : 0;
+    if (en >= r)
+      y[r] = 0, u[r] = r ? q : 0;
+    // loop fission: set scores first
+    for (t = st0; t <= en0; ++t)
+      s[t] = mat[target[t] * m + qr[t + qlen - 1 - r]];
+    // core loop; x1_ and v1_ hold the last cells of the previous vector
+    x1_ = V::set(x1);
+    v1_ = V::set(v1);
+    st_ = st >> 4, en_ = en >> 4;
+    pr = KSW_BLK(p, (size_t)r * n_col_ - st_);
+    for (t = st_; t <= en_; t += V::BLOCKS) {
+      const int n = en_ - t + 1; // blocks left
+      Vec d, z, a, b, xt1, vt1, ut, tmp;
+      Cmp c;
+
+      z = V::add(V::load(KSW_BLK(s, t)), qe2_);
+
+      tmp = V::load(KSW_BLK(x, t));
+      xt1 = V::shift_in(tmp, x1_); // xt1 <- x[r-1][t-1..t+W-2]
+      x1_ = tmp;
+      tmp = V::load(KSW_BLK(v, t));
+      vt1 = V::shift_in(tmp, v1_); // vt1 <- v[r-1][t-1..t+W-2]
+      v1_ = tmp;
+      a = V::add(xt1, vt1); // a <- x[r-1][t-1..] + v[r-1][t-1..]
+
+      ut = V::load(KSW_BLK(u, t));            // ut <- u[t..t+W-1]
+      b = V::add(V::load(KSW_BLK(y, t)), ut); // b <- y[r-1][t..] + u[r-1][t..]
+
+      d = V::keep(V::gt(a, z), flag1_); // d = a > z? 1 : 0
+      z = V::max(z, a);
+      d = V::blend(V::gt(b, z), d, flag2_); // d = b > z? 2 : d
+      z = V::umax(z, b); // this works because both are non-negative
+      V::store(KSW_BLK(u, t), V::sub(z, vt1), n); // u[r][t..] <- z - v[r-1][t-1..]
+      V::store(KSW_BLK(v, t), V::sub(z, ut), n);  // v[r][t..] <- z - u[r-1][t..]
+
+      z = V::sub(z, q_);
+      a = V::sub(a, z);
+      b = V::sub(b, z);
+      c = V::gt(a, zero_);
+      d = V::or_(d, V::keep(c, flag8_));
+      V::store(KSW_BLK(x, t), V::keep(c, a), n);
+      c = V::gt(b, zero_);
+      d = V::or_(d, V::keep(c, flag16_));
+      V::store(KSW_BLK(y, t), V::keep(c, b), n);
+      V::store(KSW_BLK(pr, t), d, n);
+    }
+    if (r > 0) {
+      if (last_H0_t >= st0 && last_H0_t <= en0)
+        H0 += v[last_H0_t] - (q + e);
+      else
+        ++last_H0_t, H0 += u[last_H0_t] - (q + e);
+    } else
+      H0 = v[0] - 2 * (q + e), last_H0_t = 0;
+    last_st = st, last_en = en;
+  }
+  kfree(km, mem);
+  kfree(km, qr);
+  ksw_backtrack(km, 1, 0, 0, p, off, 0, n_col, tlen - 1, qlen - 1, m_cigar_,
+                n_cigar_, cigar_);
+  kfree(km, mem2);
+  kfree(km, off);
+  return H0;
+}
+
+template <unsigned W> constexpr KSW2Kernels kernels(const char *isa) {
+  return {isa, extz2<KswVec<W>>, extd2<KswVec<W>>, exts2<KswVec<W>>,
+          gg2<KswVec<W>>};
+}
+
+#undef KSW_BLK
+#pragma GCC diagnostic pop
+
+} // namespace KSW2_ISA
+#endif // KSW2_ISA
@@ -0,0 +1,5 @@
+// SSE4.1 build of the ksw2 kernels (see ksw2_simd.h)
+#define KSW2_ISA ksw2_sse41
+#include "ksw2_simd.h"
+
+extern const KSW2Kernels ksw2_sse41_kernels = ksw2_sse41::kernels<128>("sse4.1");
@@ -19,8 +19,11 @@
 using namespace seq;
 using namespace std;
 
-class SeqTest : public testing::TestWithParam<
-                    tuple<const char * /*filename*/, bool /*debug*/>> {
+// with expectFailure, the program must fail to compile with the errors
+// given by its "# EXPECT: " lines
+class SeqTest
+    : public testing::TestWithParam<tuple<
+          const char * /*filename*/, bool /*debug*/, bool /*expectFailure*/>> {
 protected:
   vector<char> buf;
   int out_pipe[2];
@@ -35,6 +38,7 @@ protected:
 
   int runInChildProcess() {
     const bool debug = get<1>(GetParam());
+    const bool expectFailure = get<2>(GetParam());
     assert(pipe(out_pipe) != -1);
     pid = fork();
     GC_atfork_prepare();
@@ -46,8 +50,17 @@ protected:
       close(out_pipe[0]);
       close(out_pipe[1]);
 
-      SeqModule *module = parse("", filename(), false, false);
-      execute(module, {filename()}, {}, debug);
+      if (expectFailure) {
+        try {
+          SeqModule *module = parse("", filename(), false, true);
+          module->execute({filename()}, {});
+        } catch (exc::SeqException &e) {
+          cout << e.what() << endl;
+        }
+      } else {
+        SeqModule *module = parse("", filename(), false, false);
+        execute(module, {filename()}, {}, debug);
+      }
       fflush(stdout);
       exit(EXIT_SUCCESS);
     } else {
@@ -125,6 +138,13 @@ TEST_P(SeqTest, Run) {
   ASSERT_TRUE(WIFEXITED(status));
   ASSERT_EQ(WEXITSTATUS(status), 0);
   string output = result();
+  if (get<2>(GetParam())) {
+    vector<string> expects = findExpects(filename());
+    EXPECT_FALSE(expects.empty());
+    for (const string &expect : expects)
+      EXPECT_NE(output.find(expect), string::npos) << output;
+    return;
+  }
   const bool assertsFailed = output.find("TEST FAILED") != string::npos;
   EXPECT_FALSE(assertsFailed);
   if (assertsFailed)
@@ -214,7 +234,7 @@ INSTANTIATE_TEST_SUITE_P(
                                      "core/match.seq", "core/proteins.seq",
                                      "core/range.seq", "core/serialization.seq",
                                      "core/trees.seq"),
-                     testing::Values(true, false)),
+                     testing::Values(true, false), testing::Values(false)),
     getTestNameFromParam);
 
 INSTANTIATE_TEST_SUITE_P(
@@ -224,7 +244,7 @@ INSTANTIATE_TEST_SUITE_P(
                                      "pipeline/revcomp_opt.seq",
                                      "pipeline/canonical_opt.seq",
                                      "pipeline/interalign.seq"),
-                     testing::Values(true, false)),
+                     testing::Values(true, false), testing::Values(false)),
     getTestNameFromParam);
 
 INSTANTIATE_TEST_SUITE_P(
@@ -234,13 +254,21 @@ INSTANTIATE_TEST_SUITE_P(
                         "stdlib/itertools_test.seq", "stdlib/bisect_test.seq",
                         "stdlib/sort_test.seq", "stdlib/random_test.seq",
                         "stdlib/heapq_test.seq", "stdlib/statistics_test.seq"),
-        testing::Values(true, false)),
+        testing::Values(true, false), testing::Values(false)),
     getTestNameFromParam);
 
 INSTANTIATE_TEST_SUITE_P(
     PythonTests, SeqTest,
     testing::Combine(testing::Values("python/pybridge.seq"),
-                     testing::Values(true, false)),
+                     testing::Values(true, false), testing::Values(false)),
+    getTestNameFromParam);
+
+INSTANTIATE_TEST_SUITE_P(
+    PipelineErrorTests, SeqTest,
+    testing::Combine(testing::Values("pipeline/ordered_after_fn.seq",
+                                     "pipeline/ordered_serial.seq",
+                                     "pipeline/ordered_twice.seq"),
+                     testing::Values(false), testing::Values(true)),
     getTestNameFromParam);
 
 int main(int argc, char *argv[]) {